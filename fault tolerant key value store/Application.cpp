@@ -50,8 +50,33 @@ Application::Application(char *infile) {
 	srand (time(NULL));
 	par->setparams(infile);
 	log = new Log(par);
-	en = new EmulNet(par);
-	en1 = new EmulNet(par);
+	procs = 1;
+	rank = 0;
+	phiLog = NULL;
+	// MP1 and MP2 share one network, each on its own channel
+	if ( par->TRANSPORT == UDP_TRANSPORT && par->REPLAY.empty() ) {
+		en = new UdpNet(par, par->PORTNUM);
+	}
+	else if ( par->TRANSPORT == SHM_TRANSPORT && par->REPLAY.empty() ) {
+		// one process per node unless PROCESSES asks for fewer
+		procs = ( par->PROCESSES > 0 ) ? min(par->PROCESSES, par->EN_GPSZ) : par->EN_GPSZ;
+		en = new ShmNet(par, procs);
+	}
+	else {
+		en = new EmulNet(par);
+	}
+	en->setMsgTypes(MP1_CHANNEL, "mp1", MP1Node::msgTypeNames(), MP1Node::msgTypeOf);
+	en->setMsgTypes(MP2_CHANNEL, "mp2", MP2Node::msgTypeNames(), MP2Node::msgTypeOf);
+	if ( !par->CAPTURE.empty() ) {
+		// the node processes would all write to the one trace file
+		if ( procs > 1 ) {
+			cout<<"CAPTURE cannot record a SHM run of "<<procs<<" processes, set PROCESSES: 1"<<endl;
+			exit(1);
+		}
+		if ( !en->setCapture(par->CAPTURE.c_str()) ) {
+			cout<<"Cannot create capture file "<<par->CAPTURE<<endl;
+		}
+	}
 	mp1 = (MP1Node **) malloc(par->EN_GPSZ * sizeof(MP1Node *));
 	mp2 = (MP2Node **) malloc(par->EN_GPSZ * sizeof(MP2Node *));
 
@@ -66,7 +91,7 @@ Application::Application(char *infile) {
 		joinaddr = getjoinaddr();
 		addressOfMemberNode = (Address *) en->ENinit(addressOfMemberNode, par->PORTNUM);
 		mp1[i] = new MP1Node(memberNode, par, en, log, addressOfMemberNode);
-		mp2[i] = new MP2Node(memberNode, par, en1, log, addressOfMemberNode);
+		mp2[i] = new MP2Node(memberNode, par, en, log, addressOfMemberNode);
 		log->LOG(&(mp1[i]->getMemberNode()->addr), "APP");
 		log->LOG(&(mp2[i]->getMemberNode()->addr), "APP MP2");
 		delete addressOfMemberNode;
@@ -79,13 +104,15 @@ Application::Application(char *infile) {
 Application::~Application() {
 	delete log;
 	delete en;
-	delete en1;
 	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
 		delete mp1[i];
 		delete mp2[i];
 	}
 	free(mp1);
 	free(mp2);
+	if ( phiLog != NULL ) {
+		fclose(phiLog);
+	}
 	delete par;
 }
 
@@ -102,10 +129,21 @@ int Application::run()
 	bool allNodesJoined = false;
 	srand(time(NULL));
 
+	if ( !par->REPLAY.empty() ) {
+		return replay();
+	}
+	if ( procs > 1 && spawnProcesses() < 0 ) {
+		// the parent only waited for the node processes
+		return SUCCESS;
+	}
+
 	// As time runs along
 	for( par->globaltime = 0; par->globaltime < TOTAL_RUNNING_TIME; ++par->globaltime ) {
 		// Run the membership protocol
 		mp1Run();
+		if ( par->PHI_REPORT > 0 && par->getcurrtime() % par->PHI_REPORT == 0 ) {
+			reportPhi();
+		}
 
 		// Wait for all nodes to join
 		if ( par->allNodesJoined == nodeCount && !allNodesJoined ) {
@@ -118,19 +156,163 @@ int Application::run()
 		}
 		// Fail some nodes
 		//fail();
+
+		// deferred sends go out as far as this time unit's deliveries gave credit back
+		en->ENtick();
+
+		if ( procs > 1 ) {
+			// the next time unit starts when all processes are done with this one
+			static_cast<ShmNet *>(en)->endTick();
+		}
 	}
 
 	// Clean up
 	en->ENcleanup();
-	en1->ENcleanup();
 
 	for(i=0;i<=par->EN_GPSZ-1;i++) {
-		 mp1[i]->finishUpThisNode();
+		if ( owns(i) ) {
+			mp1[i]->finishUpThisNode();
+		}
+	}
+
+	if ( procs > 1 ) {
+		// a node process ends here, its parent returns to main
+		exit(SUCCESS);
 	}
 
 	return SUCCESS;
 }
 
+/**
+ * FUNCTION NAME: spawnProcesses
+ *
+ * DESCRIPTION: Fork procs node processes sharing the ShmNet segments. Process rank runs
+ * 				the nodes i with i % procs == rank and is pinned to a core of its own where
+ * 				there are enough. Each works in a directory proc<rank> so its reports stay
+ * 				apart; dbg.log and stats.log were opened before the fork and are shared.
+ *
+ * RETURNS:
+ * the rank in a node process, -1 in the parent once all node processes are done
+ */
+int Application::spawnProcesses() {
+	char dir[32];
+	int status, failed = 0;
+	long cores = sysconf(_SC_NPROCESSORS_ONLN);
+
+	// whatever stdio holds would otherwise be written once by every process
+	fflush(NULL);
+
+	for ( int r = 0; r < procs; r++ ) {
+		pid_t pid = fork();
+		if ( pid < 0 ) {
+			perror("fork");
+			exit(1);
+		}
+		if ( pid == 0 ) {
+			rank = r;
+			srand(time(NULL) ^ getpid());
+
+			cpu_set_t cpus;
+			CPU_ZERO(&cpus);
+			CPU_SET(r % (cores > 0 ? cores : 1), &cpus);
+			sched_setaffinity(0, sizeof(cpus), &cpus);
+
+			sprintf(dir, "proc%d", r);
+			mkdir(dir, 0755);
+			if ( chdir(dir) < 0 ) {
+				perror("chdir");
+				exit(1);
+			}
+			return rank;
+		}
+	}
+
+	for ( int r = 0; r < procs; r++ ) {
+		if ( wait(&status) < 0 || !WIFEXITED(status) || WEXITSTATUS(status) != SUCCESS ) {
+			failed++;
+		}
+	}
+	if ( failed > 0 ) {
+		cout<<failed<<" of "<<procs<<" node processes failed"<<endl;
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: replay
+ *
+ * DESCRIPTION: Feed a trace recorded with CAPTURE back into the message handlers of the nodes,
+ * 				each message on the channel it was sent on: MP1Node::recvCallBack for MP1 traffic
+ * 				and MP2Node::checkMessages for MP2 traffic.
+ * 				Nothing else of the simulation runs: no heartbeats, no ring updates, no tests,
+ * 				and whatever the handlers send is dropped. Reports the time the handlers took.
+ */
+int Application::replay() {
+	CaptureReader trace;
+	cap_record rec;
+	char *data;
+	long replayed[EN_CHANNELS] = {0};
+	int i, tick = -1;
+
+	if ( !trace.open(par->REPLAY.c_str()) ) {
+		cout<<"Cannot read trace "<<par->REPLAY<<endl;
+		return FAILURE;
+	}
+	en->setReplaying(true);
+
+	// bring every node up, their membership and KV state is then built by the trace alone
+	par->globaltime = 0;
+	for ( i = 0; i < par->EN_GPSZ; i++ ) {
+		mp1[i]->nodeStart(JOINADDR, par->PORTNUM);
+	}
+
+	chrono::steady_clock::time_point begin = chrono::steady_clock::now();
+	while ( trace.next(&rec, &data) ) {
+		if ( rec.tick != tick ) {
+			replayTick();
+			tick = rec.tick;
+			par->globaltime = tick;
+		}
+		if ( rec.to < 1 || rec.to > par->EN_GPSZ || rec.channel < 0 || rec.channel >= EN_CHANNELS ) {
+			continue;
+		}
+		// emulnet ids are handed out in node order starting at 1
+		en->ENdeliver(rec.from, &(mp1[rec.to - 1]->getMemberNode()->addr), data, rec.size, rec.channel);
+		replayed[rec.channel]++;
+	}
+	replayTick();
+	double ms = chrono::duration<double, milli>(chrono::steady_clock::now() - begin).count();
+	long total = replayed[MP1_CHANNEL] + replayed[MP2_CHANNEL];
+
+	cout<<"Replayed "<<replayed[MP1_CHANNEL]<<" MP1 and "<<replayed[MP2_CHANNEL]<<" MP2 messages up to time "<<tick<<" in "<<ms<<" ms";
+	if ( ms > 0 ) {
+		cout<<" ("<<(long) (total / ms * 1000)<<" msgs/s)";
+	}
+	cout<<endl;
+
+	en->ENcleanup();
+
+	for ( i = 0; i < par->EN_GPSZ; i++ ) {
+		mp1[i]->finishUpThisNode();
+	}
+
+	return SUCCESS;
+}
+
+/**
+ * FUNCTION NAME: replayTick
+ *
+ * DESCRIPTION: Hand the messages replayed for the current time unit to the handlers of every node
+ */
+void Application::replayTick() {
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		mp1[i]->recvLoop();
+		mp1[i]->checkMessages();
+		mp2[i]->recvLoop();
+		mp2[i]->checkMessages();
+	}
+}
+
 /**
  * FUNCTION NAME: mp1Run
  *
@@ -145,7 +327,7 @@ void Application::mp1Run() {
 		/*
 		 * Receive messages from the network and queue them in the membership protocol queue
 		 */
-		if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
+		if( owns(i) && par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
 			// Receive messages from the network and queue them
 			mp1[i]->recvLoop();
 		}
@@ -159,16 +341,20 @@ void Application::mp1Run() {
 		 * Introduce nodes into the distributed system
 		 */
 		if( par->getcurrtime() == (int)(par->STEP_RATE*i) ) {
+			// every process counts all introductions, the count decides when the KV store starts
+			nodeCount += i;
+			if ( !owns(i) ) {
+				continue;
+			}
 			// introduce the ith node into the system at time STEPRATE*i
 			mp1[i]->nodeStart(JOINADDR, par->PORTNUM);
 			cout<<i<<"-th introduced node is assigned with the address: "<<mp1[i]->getMemberNode()->addr.getAddress() << endl;
-			nodeCount += i;
 		}
 
 		/*
 		 * Handle all the messages in your queue and send heartbeats
 		 */
-		else if( par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
+		else if( owns(i) && par->getcurrtime() > (int)(par->STEP_RATE*i) && !(mp1[i]->getMemberNode()->bFailed) ) {
 			// handle messages and send heartbeats
 			mp1[i]->nodeLoop();
 			#ifdef DEBUGLOG
@@ -181,6 +367,32 @@ void Application::mp1Run() {
 	}
 }
 
+/**
+ * FUNCTION NAME: reportPhi
+ *
+ * DESCRIPTION: Append the suspicion level every live node has of each of its members to phi.log,
+ * 				one "time node member heartbeat phi" line per member
+ */
+void Application::reportPhi() {
+	if ( phiLog == NULL ) {
+		phiLog = fopen("phi.log", "w");
+		if ( phiLog == NULL ) {
+			return;
+		}
+	}
+	for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		Member *node = mp1[i]->getMemberNode();
+		if ( !owns(i) || node->bFailed || !node->inGroup ) {
+			continue;
+		}
+		for ( unsigned int j = 0; j < node->memberList.size(); j++ ) {
+			MemberListEntry *mle = &node->memberList[j];
+			fprintf(phiLog, "%d %s %d:%d %ld %.2f\n", par->getcurrtime(), node->addr.getAddress().c_str(),
+					mle->getid(), mle->getport(), mle->getheartbeat(), mp1[i]->phi(mle));
+		}
+	}
+}
+
 /**
  * FUNCTION NAME: mp2Run
  *
@@ -199,7 +411,7 @@ void Application::mp2Run() {
 		 * 1) Update the ring
 		 * 2) Receive messages from the network and queue them in the KV store queue
 		 */
-		if ( par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
+		if ( owns(i) && par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
 			if ( mp2[i]->getMemberNode()->inited && mp2[i]->getMemberNode()->inGroup ) {
 				// Step 1
 				mp2[i]->updateRing();
@@ -213,11 +425,21 @@ void Application::mp2Run() {
 	 * Handle messages from the queue and update the DHT
 	 */
 	for ( i = par->EN_GPSZ-1; i >= 0; i-- ) {
-		if ( par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
+		if ( owns(i) && par->getcurrtime() > (int)(par->STEP_RATE*i) && !mp2[i]->getMemberNode()->bFailed ) {
 			mp2[i]->checkMessages();
 		}
 	}
 
+	/**
+	 * The tests pick their nodes across the whole system, they only run when all nodes live in this process
+	 */
+	if ( procs > 1 ) {
+		if ( rank == 0 && par->getcurrtime() == INSERT_TIME ) {
+			cout<<"CRUD tests skipped: the nodes run in "<<procs<<" processes, set PROCESSES: 1 to test them"<<endl;
+		}
+		return;
+	}
+
 	/**
 	 * Insert a set of test key value pairs into the system
 	 */
@@ -523,7 +745,8 @@ void Application::readTest() {
 			exit(1);
 		}
 
-		// Step 2.c Fail a replica
+		// Step 2.c Fail a replica, the last one found if there are only quorum of them
+		replicaIdToFail = min(replicaIdToFail, (int) replicas.size() - 1);
 		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
 			if ( mp2[i]->getMemberNode()->addr.getAddress() == replicas.at(replicaIdToFail).getAddress()->getAddress() ) {
 				if ( !mp2[i]->getMemberNode()->bFailed ) {
@@ -666,7 +889,12 @@ void Application::readTest() {
 		// Step 4.b Find a non - replica for this key
 		replicas.clear();
 		replicas = mp2[number]->findNodes(it->first);
-		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( replicas.size() < RF ) {
+			// without all the replicas a non-replica cannot be told apart, the test fails below
+			log->LOG(&mp2[number]->getMemberNode()->addr, "Could not find all replicas for this key. size of replicas vector: %d", replicas.size());
+			cout<<endl<<"Could not find all replicas for this key. size of replicas vector: "<<replicas.size()<<endl;
+		}
+		for ( int i = 0; i < par->EN_GPSZ && replicas.size() >= RF; i++ ) {
 			if ( !mp2[i]->getMemberNode()->bFailed ) {
 				if ( mp2[i]->getMemberNode()->addr.getAddress() != replicas.at(PRIMARY).getAddress()->getAddress() &&
 					 mp2[i]->getMemberNode()->addr.getAddress() != replicas.at(SECONDARY).getAddress()->getAddress() &&
@@ -768,7 +996,8 @@ void Application::updateTest() {
 			exit(1);
 		}
 
-		// Step 2.c Fail a replica
+		// Step 2.c Fail a replica, the last one found if there are only quorum of them
+		replicaIdToFail = min(replicaIdToFail, (int) replicas.size() - 1);
 		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
 			if ( mp2[i]->getMemberNode()->addr.getAddress() == replicas.at(replicaIdToFail).getAddress()->getAddress() ) {
 				if ( !mp2[i]->getMemberNode()->bFailed ) {
@@ -908,7 +1137,12 @@ void Application::updateTest() {
 		// Step 4.b Find a non - replica for this key
 		replicas.clear();
 		replicas = mp2[number]->findNodes(it->first);
-		for ( int i = 0; i < par->EN_GPSZ; i++ ) {
+		if ( replicas.size() < RF ) {
+			// without all the replicas a non-replica cannot be told apart, the test fails below
+			log->LOG(&mp2[number]->getMemberNode()->addr, "Could not find all replicas for this key. size of replicas vector: %d", replicas.size());
+			cout<<endl<<"Could not find all replicas for this key. size of replicas vector: "<<replicas.size()<<endl;
+		}
+		for ( int i = 0; i < par->EN_GPSZ && replicas.size() >= RF; i++ ) {
 			if ( !mp2[i]->getMemberNode()->bFailed ) {
 				if ( mp2[i]->getMemberNode()->addr.getAddress() != replicas.at(PRIMARY).getAddress()->getAddress() &&
 					 mp2[i]->getMemberNode()->addr.getAddress() != replicas.at(SECONDARY).getAddress()->getAddress() &&
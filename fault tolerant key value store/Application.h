@@ -13,6 +13,11 @@
 #include "Params.h"
 #include "Member.h"
 #include "EmulNet.h"
+#include "UdpNet.h"
+#include "ShmNet.h"
+#include "MsgCapture.h"
+#include <sched.h>
+#include <sys/wait.h>
 #include "Queue.h"
 #include "MP2Node.h"
 #include "Node.h"
@@ -52,19 +57,30 @@ private:
 	// Coordinator Node
 	char JOINADDR[30];
 	EmulNet *en;
-	EmulNet *en1;
     Log *log;
 	MP1Node **mp1;
 	MP2Node **mp2;
 	Params *par;
 	map<string, string> testKVPairs;
+	// processes the nodes are spread over and the one this is, see spawnProcesses
+	int procs;
+	int rank;
+	// suspicion levels written every PHI_REPORT time units
+	FILE *phiLog;
+	bool owns(int i) {
+		return i % procs == rank;
+	}
 public:
 	Application(char *);
 	virtual ~Application();
 	Address getjoinaddr();
 	void initTestKVPairs();
 	int run();
+	int spawnProcesses();
+	int replay();
+	void replayTick();
 	void mp1Run();
+	void reportPhi();
 	void mp2Run();
 	void fail();
 	void insertTestKVPairs();
@@ -6,39 +6,50 @@
 
 #include "EmulNet.h"
 
+thread_local int EmulNet::lastSendStatus = EN_SENT;
+
 /**
  * Constructor
  */
-EmulNet::EmulNet(Params *p)
+EmulNet::EmulNet(Params *p): faults(p), link(p)
 {
 	//trace.funcEntry("EmulNet::EmulNet");
-	int i,j;
 	par = p;
 	emulnet.setNextId(1);
 	emulnet.settCurrBuffSize(0);
 	enInited=0;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			sent_msgs[i][j] = 0;
-			recv_msgs[i][j] = 0;
-		}
-	}
+	replaying = false;
+	channelLabels.push_back("mp1");
+	channelLabels.push_back("mp2");
+	channelTypes.resize(EN_CHANNELS);
+	classify.assign(EN_CHANNELS, NULL);
+	layoutTypes();
+	sent_msgs.init(par->EN_GPSZ);
+	recv_msgs.init(par->EN_GPSZ);
+	// sized up front, so senders and receivers on other threads never see them grow
+	emulnet.getMailbox(par->EN_GPSZ, EN_CHANNELS - 1);
+	emulnet.getSender(par->EN_GPSZ);
+	delayHist.resize(par->EN_GPSZ + 1);
 	//trace.funcExit("EmulNet::EmulNet", SUCCESS);
 }
 
 /**
  * Copy constructor
  */
-EmulNet::EmulNet(EmulNet &anotherEmulNet) {
-	int i, j;
+EmulNet::EmulNet(EmulNet &anotherEmulNet): faults(anotherEmulNet.par), link(anotherEmulNet.par) {
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->replaying = anotherEmulNet.replaying;
+	this->traffic = anotherEmulNet.traffic;
+	this->channelLabels = anotherEmulNet.channelLabels;
+	this->channelTypes = anotherEmulNet.channelTypes;
+	this->classify = anotherEmulNet.classify;
+	this->typeBase = anotherEmulNet.typeBase;
+	this->typeNames = anotherEmulNet.typeNames;
+	this->typeChannel = anotherEmulNet.typeChannel;
+	this->sent_msgs = anotherEmulNet.sent_msgs;
+	this->recv_msgs = anotherEmulNet.recv_msgs;
+	this->delayHist = anotherEmulNet.delayHist;
 	this->emulnet = anotherEmulNet.emulnet;
 }
 
@@ -46,15 +57,19 @@ EmulNet::EmulNet(EmulNet &anotherEmulNet) {
  * Assignment operator overloading
  */
 EmulNet& EmulNet::operator =(EmulNet &anotherEmulNet) {
-	int i, j;
 	this->par = anotherEmulNet.par;
 	this->enInited = anotherEmulNet.enInited;
-	for ( i = 0; i < MAX_NODES; i++ ) {
-		for ( j = 0; j < MAX_TIME; j++ ) {
-			this->sent_msgs[i][j] = anotherEmulNet.sent_msgs[i][j];
-			this->recv_msgs[i][j] = anotherEmulNet.recv_msgs[i][j];
-		}
-	}
+	this->replaying = anotherEmulNet.replaying;
+	this->traffic = anotherEmulNet.traffic;
+	this->channelLabels = anotherEmulNet.channelLabels;
+	this->channelTypes = anotherEmulNet.channelTypes;
+	this->classify = anotherEmulNet.classify;
+	this->typeBase = anotherEmulNet.typeBase;
+	this->typeNames = anotherEmulNet.typeNames;
+	this->typeChannel = anotherEmulNet.typeChannel;
+	this->sent_msgs = anotherEmulNet.sent_msgs;
+	this->recv_msgs = anotherEmulNet.recv_msgs;
+	this->delayHist = anotherEmulNet.delayHist;
 	this->emulnet = anotherEmulNet.emulnet;
 	return *this;
 }
@@ -71,8 +86,10 @@ EmulNet::~EmulNet() {}
  */
 void *EmulNet::ENinit(Address *myaddr, short port) {
 	// Initialize data structures for this member
-	*(int *)(myaddr->addr) = emulnet.nextid++;
+	int id = emulnet.nextid++;
+	*(int *)(myaddr->addr) = id;
     *(short *)(&myaddr->addr[4]) = 0;
+	emulnet.getMailbox(id, EN_CHANNELS - 1);
 	return myaddr;
 }
 
@@ -80,100 +97,589 @@ void *EmulNet::ENinit(Address *myaddr, short port) {
  * FUNCTION NAME: ENsend
  *
  * DESCRIPTION: EmulNet send function
+ * 				getLastSendStatus() tells whether the message was sent, deferred or dropped
  *
  * RETURNS:
  * size
  */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size) {
-	en_msg *em;
-	static char temp[2048];
-	int sendmsg = rand() % 100;
+int EmulNet::ENsend(Address *myaddr, Address *toaddr, char *data, int size, int channel) {
+	return this->ENsendMulti(myaddr, toaddr, 1, data, size, channel);
+}
+
+/**
+ * FUNCTION NAME: ENsendMulti
+ *
+ * DESCRIPTION: EmulNet multicast send function
+ * 				The payload is copied once into a reference counted buffer and the mailbox
+ * 				on channel of every destination holds a reference to it. Each destination is
+ * 				subject to message drops and flow control on its own, as with separate sends.
+ *
+ * 				A sender may have at most SEND_CREDITS messages in flight on each channel, a message
+ * 				being in flight until the end of the time unit it falls due in, and the network holds
+ * 				at most ENBUFFSIZE. A send beyond either limit is not lost but deferred to the sender
+ * 				backlog of its channel, which is drained in order before the next send of the sender
+ * 				and once every time unit by ENtick, as far as credit came back. A send only waits
+ * 				behind older deferred sends to the same destination. Only a full backlog drops a send.
+ * 				The outcome for every destination is written to status when it is given.
+ *
+ * 				Accepted sends are appended to the capture trace when one is open.
+ * 				While a trace is replayed nothing is sent at all.
+ *
+ * 				Nodes may send from different threads at once, see en_mailbox.
+ *
+ * RETURNS:
+ * size if at least one destination got or will get the message, 0 otherwise
+ */
+int EmulNet::ENsendMulti(Address *myaddr, Address *toaddrs, int count, char *data, int size, int channel, int *status) {
+	en_msg *em = NULL;
+	static thread_local char temp[2048];
+	// outcome per destination when the caller does not ask for it, one per sending thread
+	static thread_local vector<int> outcome;
+
+	if ( status == NULL ) {
+		outcome.resize(count);
+		status = count > 0 ? &outcome[0] : NULL;
+	}
+	for ( int i = 0; i < count; i++ ) {
+		status[i] = EN_DROPPED;
+	}
+	lastSendStatus = EN_DROPPED;
+
+	if( size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE ) {
+		return 0;
+	}
+	if ( replaying ) {
+		// the traffic that follows is already in the trace
+		for ( int i = 0; i < count; i++ ) {
+			status[i] = EN_SENT;
+		}
+		lastSendStatus = EN_SENT;
+		return size;
+	}
 
-	if( (emulnet.currbuffsize >= ENBUFFSIZE) || (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100)) ) {
+	int src = *(int *)(myaddr->addr);
+	int time = par->getcurrtime();
+	int type = msgType(channel, data, size);
+	en_sender &sender = emulnet.getSender(src);
+	en_backlog &backlog = sender.backlog[channel];
+	int sending = 0, deferring = 0;
+
+	// older sends get the credit handed back since they were deferred first
+	if ( !backlog.sends.empty() ) {
+		drainBacklog(src, channel);
+	}
+
+	/*
+	 * Decide for every destination first. Once the message is in one mailbox, another thread
+	 * may receive and release it, so its reference count must be complete before it goes out.
+	 */
+	for ( int i = 0; i < count; i++ ) {
+		int dst = *(int *)(toaddrs[i].addr);
+		int sendmsg = rand() % 100;
+
+		if( par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100) ) {
+			continue;
+		}
+		if ( faults.isEnabled() && faults.blocks(src, dst, time) ) {
+			continue;
+		}
+
+		// a send behind a deferred one to the same destination waits too, or it would overtake it
+		if ( backlog.waiting.count(dst) == 0 && hasCredit(src, channel, sending) ) {
+			status[i] = EN_SENT;
+			sending++;
+		}
+		else if ( (int) backlog.sends.size() + deferring < EN_BACKLOG_LIMIT ) {
+			status[i] = EN_DEFERRED;
+			deferring++;
+		}
+		else {
+			sender.dropped++;
+		}
+	}
+
+	if ( sending + deferring == 0 ) {
 		return 0;
 	}
 
-	em = (en_msg *)malloc(sizeof(en_msg) + size);
+	em = new (pool.allocate(sizeof(en_msg) + size)) en_msg();
 	em->size = size;
+	em->refs = sending + deferring;
+	em->from = *myaddr;
+	em->to = toaddrs[0];
+	em->channel = channel;
+	memcpy((char *)(em + 1), data, size);
+
+	for ( int i = 0; i < count; i++ ) {
+		Address *toaddr = &toaddrs[i];
+		int dst = *(int *)(toaddr->addr);
+
+		if ( status[i] == EN_DROPPED ) {
+			continue;
+		}
+		if ( capture.isOpen() ) {
+			capture.write(time, src, dst, channel, data, size);
+		}
 
-	memcpy(&(em->from.addr), &(myaddr->addr), sizeof(em->from.addr));
-	memcpy(&(em->to.addr), &(toaddr->addr), sizeof(em->from.addr));
-	memcpy(em + 1, data, size);
+		if ( status[i] == EN_DEFERRED ) {
+			en_deferred deferred;
+			deferred.dst = dst;
+			deferred.sentAt = time;
+			deferred.msg = em;
+			backlog.sends.push_back(deferred);
+			backlog.waiting[dst]++;
+			sender.deferred++;
+			emulnet.backlogged++;
+		}
+		else {
+			dispatch(em, src, dst, time);
+		}
 
-	emulnet.buff[emulnet.currbuffsize++] = em;
+		sent_msgs.incr(src, time);
+		traffic.sent(src, time, type, size);
 
-	int src = *(int *)(myaddr->addr);
+		#ifdef DEBUGLOG
+			sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
+		#endif
+	}
+	lastSendStatus = status[count - 1];
+
+	return size;
+}
+
+/**
+ * FUNCTION NAME: hasCredit
+ *
+ * DESCRIPTION: True if src may put one more message in flight on channel on top of extra it is about to send.
+ * 				Senders on other threads may take the last credits at the same time, so the
+ * 				limits can be overshot by a message per sending thread.
+ */
+bool EmulNet::hasCredit(int src, int channel, int extra) {
+	if ( emulnet.currbuffsize + extra >= ENBUFFSIZE ) {
+		return false;
+	}
+	return par->SEND_CREDITS <= 0 || emulnet.getSender(src).inFlight[channel] + extra < par->SEND_CREDITS;
+}
+
+/**
+ * FUNCTION NAME: dispatch
+ *
+ * DESCRIPTION: Push a message into the inbox of the destination, charging one credit to the sender
+ */
+void EmulNet::dispatch(en_msg *em, int src, int dst, int sentAt) {
 	int time = par->getcurrtime();
 
-	assert(src <= MAX_NODES);
-	assert(time < MAX_TIME);
+	en_inbound *in = new (pool.allocate(sizeof(en_inbound))) en_inbound;
+	in->pending.sentAt = sentAt;
+	in->pending.enteredAt = time;
+	in->pending.deliverAt = link.isEnabled() ? link.deliveryTime(src, dst, sizeof(en_msg) + em->size, time) : time;
+	in->pending.seq = emulnet.nextseq++;
+	in->pending.msg = em;
+	emulnet.currbuffsize++;
+	en_sender &sender = emulnet.getSender(src);
+	sender.inFlight[em->channel]++;
+	sender.dueAt[em->channel][in->pending.deliverAt]++;
+	emulnet.getMailbox(dst, em->channel).inbox.push(in);
+}
+
+/**
+ * FUNCTION NAME: collect
+ *
+ * DESCRIPTION: Move what arrived in the inbox of a mailbox to its delivery queue.
+ * 				Only the thread running the owner of the mailbox may call this.
+ */
+void EmulNet::collect(en_mailbox &mailbox) {
+	en_inbound *in;
+	while ( (in = mailbox.inbox.pop()) != NULL ) {
+		mailbox.due.push(in->pending);
+		in->~en_inbound();
+		pool.release(in, sizeof(en_inbound));
+	}
+}
 
-	sent_msgs[src][time]++;
+/**
+ * FUNCTION NAME: drainBacklog
+ *
+ * DESCRIPTION: Dispatch the deferred sends of src on channel, oldest first, while credit lasts.
+ * 				A fault that struck while a send waited drops it here.
+ * 				Only the thread running src touches its backlog, or ENtick between time units.
+ */
+void EmulNet::drainBacklog(int src, int channel) {
+	en_backlog &backlog = emulnet.getSender(src).backlog[channel];
+	int time = par->getcurrtime();
 
-	#ifdef DEBUGLOG
-		sprintf(temp, "Sending 4+%d B msg type %d to %d.%d.%d.%d:%d ", size-4, *(int *)data, toaddr->addr[0], toaddr->addr[1], toaddr->addr[2], toaddr->addr[3], *(short *)&toaddr->addr[4]);
-	#endif
+	while ( !backlog.sends.empty() && hasCredit(src, channel, 0) ) {
+		en_deferred &deferred = backlog.sends.front();
+		map<int, int>::iterator waits = backlog.waiting.find(deferred.dst);
+		if ( --waits->second == 0 ) {
+			backlog.waiting.erase(waits);
+		}
+		if ( faults.isEnabled() && faults.blocksSince(src, deferred.dst, deferred.sentAt, time) ) {
+			ENrelease(deferred.msg + 1);
+		}
+		else {
+			dispatch(deferred.msg, src, deferred.dst, deferred.sentAt);
+		}
+		backlog.sends.pop_front();
+		emulnet.backlogged--;
+	}
+}
 
-	return size;
+/**
+ * FUNCTION NAME: ENtick
+ *
+ * DESCRIPTION: Hand back the credits of every message that fell due in this time unit, then drain
+ * 				the backlog of every sender on every channel, so deferred sends go out even if their
+ * 				sender sends nothing more. A message to a node that stopped receiving gives its
+ * 				credit back all the same. Called once at the end of every time unit, while no node runs.
+ */
+void EmulNet::ENtick() {
+	int time = par->getcurrtime();
+
+	for ( int i = 0; i < (int) emulnet.senders.size(); i++ ) {
+		en_sender &sender = emulnet.senders[i];
+		for ( int c = 0; c < EN_CHANNELS; c++ ) {
+			map<int, int> &due = sender.dueAt[c];
+			while ( !due.empty() && due.begin()->first <= time ) {
+				sender.inFlight[c] -= due.begin()->second;
+				due.erase(due.begin());
+			}
+			if ( !sender.backlog[c].sends.empty() ) {
+				drainBacklog(i, c);
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: ENsendMulti
+ *
+ * DESCRIPTION: EmulNet multicast send function
+ *
+ * RETURNS:
+ * size
+ */
+int EmulNet::ENsendMulti(Address *myaddr, vector<Address> &toaddrs, char *data, int size, int channel) {
+	if ( toaddrs.empty() ) {
+		return 0;
+	}
+	return this->ENsendMulti(myaddr, &toaddrs[0], toaddrs.size(), data, size, channel);
+}
+
+/**
+ * FUNCTION NAME: ENsendMulti
+ *
+ * DESCRIPTION: EmulNet multicast send function
+ *
+ * RETURNS:
+ * size
+ */
+int EmulNet::ENsendMulti(Address *myaddr, vector<Address> &toaddrs, string data, int channel) {
+	return this->ENsendMulti(myaddr, toaddrs, (char *)data.data(), (data.length() * sizeof(char)), channel);
 }
 
 /**
  * FUNCTION NAME: ENsend
  *
  * DESCRIPTION: EmulNet send function
+ * 				The string contents are copied straight into the message buffer
  *
  * RETURNS:
  * size
  */
-int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data) {
-	char * str = (char *) malloc(data.length() * sizeof(char));
-	memcpy(str, data.c_str(), data.size());
-	int ret = this->ENsend(myaddr, toaddr, str, (data.length() * sizeof(char)));
-	free(str);
-	return ret;
+int EmulNet::ENsend(Address *myaddr, Address *toaddr, string data, int channel) {
+	return this->ENsend(myaddr, toaddr, (char *)data.data(), (data.length() * sizeof(char)), channel);
 }
 
 /**
  * FUNCTION NAME: ENrecv
  *
  * DESCRIPTION: EmulNet receive function
+ * 				Only messages on channel whose delivery time has come are handed out.
+ * 				A fault that struck while a message was in flight drops it here.
+ * 				The payload handed to enq still lives in the buffer allocated by ENsend,
+ * 				so the consumer owns it and must give it back through ENrelease.
+ * 				Each node must receive from one thread at a time.
  *
  * RETURN:
  * 0
  */
-int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue){
+int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue, int channel){
 	// times is always assumed to be 1
-	int i;
-	char* tmp;
-	int sz;
 	en_msg *emsg;
+	int dst = *(int *)(myaddr->addr);
+	int time = par->getcurrtime();
+	en_mailbox &mailbox = emulnet.getMailbox(dst, channel);
+	if ( dst >= (int) delayHist.size() ) {
+		delayHist.resize(dst + 1);
+	}
+	vector<long> &hist = delayHist[dst];
 
-	for( i = emulnet.currbuffsize - 1; i >= 0; i-- ) {
-		emsg = emulnet.buff[i];
+	collect(mailbox);
 
-		if ( 0 == strcmp(emsg->to.addr, myaddr->addr) ) {
-			sz = emsg->size;
-			tmp = (char *) malloc(sz * sizeof(char));
-			memcpy(tmp, (char *)(emsg+1), sz);
+	while ( !mailbox.due.empty() && mailbox.due.top().deliverAt <= time ) {
+		const en_pending &pending = mailbox.due.top();
+		emsg = pending.msg;
+		unsigned int delay = time - pending.sentAt;
+		bool lost = faults.isEnabled() && faults.blocksSince(*(int *)(emsg->from.addr), dst, pending.enteredAt, pending.deliverAt);
+		mailbox.due.pop();
+		emulnet.currbuffsize--;
 
-			emulnet.buff[i] = emulnet.buff[emulnet.currbuffsize-1];
-			emulnet.currbuffsize--;
+		if ( lost ) {
+			ENrelease(emsg + 1);
+			continue;
+		}
+
+		(*enq)(queue, (char *)(emsg+1), emsg->size);
+
+		recv_msgs.incr(dst, time);
+		traffic.received(dst, time, msgType(channel, (char *)(emsg+1), emsg->size), emsg->size);
+		if ( delay >= hist.size() ) {
+			hist.resize(delay + 1, 0);
+		}
+		hist[delay]++;
+	}
+
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: ENrelease
+ *
+ * DESCRIPTION: Give back a payload handed out by ENrecv once the consumer is done with it.
+ * 				The buffer goes back to the pool when its last receiver lets go,
+ * 				whichever thread that is.
+ */
+void EmulNet::ENrelease(void *data) {
+	if ( data != NULL ) {
+		en_msg *em = (en_msg *)data - 1;
+		if ( __atomic_sub_fetch(&em->refs, 1, __ATOMIC_ACQ_REL) <= 0 ) {
+			pool.release(em, sizeof(en_msg) + em->size);
+		}
+	}
+}
 
-			(*enq)(queue, (char *)tmp, sz);
+/**
+ * FUNCTION NAME: setCapture
+ *
+ * DESCRIPTION: Record every accepted send on any channel to a binary trace at path, see MsgCapture.h
+ *
+ * RETURNS:
+ * true if the trace could be created
+ */
+bool EmulNet::setCapture(const char *path) {
+	return capture.open(path);
+}
 
-			free(emsg);
+/**
+ * FUNCTION NAME: setMsgTypes
+ *
+ * DESCRIPTION: Break the traffic of a channel down by message type. classify maps a payload
+ * 				to an index into names. The breakdown is written to traffic.csv by ENcleanup.
+ * 				Resets the traffic counters, so it is meant to be called before anything is sent.
+ */
+void EmulNet::setMsgTypes(int channel, string label, const vector<string> &names, en_classifier classify) {
+	this->channelLabels[channel] = label;
+	this->channelTypes[channel] = names;
+	this->classify[channel] = classify;
+	layoutTypes();
+}
 
-			int dst = *(int *)(myaddr->addr);
-			int time = par->getcurrtime();
+/**
+ * FUNCTION NAME: layoutTypes
+ *
+ * DESCRIPTION: Lay the types of all channels out one after the other, each channel closed by OTHER
+ */
+void EmulNet::layoutTypes() {
+	typeNames.clear();
+	typeChannel.clear();
+	typeBase.assign(EN_CHANNELS, 0);
+	for ( int c = 0; c < EN_CHANNELS; c++ ) {
+		typeBase[c] = typeNames.size();
+		typeNames.insert(typeNames.end(), channelTypes[c].begin(), channelTypes[c].end());
+		typeNames.push_back("OTHER");
+		typeChannel.resize(typeNames.size(), c);
+	}
+	traffic.init(par->EN_GPSZ, typeNames.size());
+}
 
-			assert(dst <= MAX_NODES);
-			assert(time < MAX_TIME);
+/**
+ * FUNCTION NAME: msgType
+ *
+ * DESCRIPTION: Index of the message type of a payload on channel in typeNames
+ */
+int EmulNet::msgType(int channel, char *data, int size) {
+	int other = typeBase[channel] + channelTypes[channel].size();
+	if ( classify[channel] == NULL ) {
+		return other;
+	}
+	int type = classify[channel](data, size);
+	if ( type < 0 || type >= (int) channelTypes[channel].size() ) {
+		return other;
+	}
+	return typeBase[channel] + type;
+}
 
-			recv_msgs[dst][time]++;
+/**
+ * FUNCTION NAME: printTrafficStats
+ *
+ * DESCRIPTION: Write the traffic of every node by time unit, channel and message type as CSV,
+ * 				leaving out the cells where nothing was sent or received.
+ * 				The totals per type follow as rows with tick -1.
+ */
+void EmulNet::printTrafficStats() {
+	vector<en_traffic> totals(traffic.ntypes);
+	int node, t, type;
+
+	FILE* file = fopen("traffic.csv", "w+");
+
+	fprintf(file, "node,tick,channel,type,sent_msgs,sent_bytes,recv_msgs,recv_bytes\n");
+	for ( node = 0; node < (int) traffic.cells.size(); node++ ) {
+		vector<en_traffic> &perTime = traffic.cells[node];
+		for ( t = 0; t * traffic.ntypes < (int) perTime.size(); t++ ) {
+			for ( type = 0; type < traffic.ntypes; type++ ) {
+				en_traffic &c = perTime[t * traffic.ntypes + type];
+				if ( c.sentMsgs == 0 && c.recvMsgs == 0 ) {
+					continue;
+				}
+				fprintf(file, "%d,%d,%s,%s,%d,%ld,%d,%ld\n", node, t, channelLabels[typeChannel[type]].c_str(), typeNames[type].c_str(), c.sentMsgs, c.sentBytes, c.recvMsgs, c.recvBytes);
+				totals[type].sentMsgs += c.sentMsgs;
+				totals[type].sentBytes += c.sentBytes;
+				totals[type].recvMsgs += c.recvMsgs;
+				totals[type].recvBytes += c.recvBytes;
+			}
 		}
 	}
+	for ( type = 0; type < traffic.ntypes; type++ ) {
+		fprintf(file, "0,-1,%s,%s,%d,%ld,%d,%ld\n", channelLabels[typeChannel[type]].c_str(), typeNames[type].c_str(), totals[type].sentMsgs, totals[type].sentBytes, totals[type].recvMsgs, totals[type].recvBytes);
+	}
 
-	return 0;
+	fclose(file);
+}
+
+/**
+ * FUNCTION NAME: ENdeliver
+ *
+ * DESCRIPTION: Put a message straight into the mailbox of toaddr on channel, due now. Used to replay a trace:
+ * 				drops, faults, flow control and the link model were already applied when it was captured.
+ *
+ * RETURNS:
+ * size
+ */
+int EmulNet::ENdeliver(int from, Address *toaddr, char *data, int size, int channel) {
+	int dst = *(int *)(toaddr->addr);
+	int time = par->getcurrtime();
+
+	// value-initialised, so the port of from is zero
+	en_msg *em = new (pool.allocate(sizeof(en_msg) + size)) en_msg();
+	em->size = size;
+	em->refs = 1;
+	memcpy(em->from.addr, &from, sizeof(int));
+	em->to = *toaddr;
+	em->channel = channel;
+	memcpy((char *)(em + 1), data, size);
+
+	en_inbound *in = new (pool.allocate(sizeof(en_inbound))) en_inbound;
+	in->pending.sentAt = time;
+	in->pending.enteredAt = time;
+	in->pending.deliverAt = time;
+	in->pending.seq = emulnet.nextseq++;
+	in->pending.msg = em;
+	emulnet.currbuffsize++;
+	emulnet.getMailbox(dst, channel).inbox.push(in);
+
+	return size;
+}
+
+/**
+ * FUNCTION NAME: printDelayStats
+ *
+ * DESCRIPTION: Write the distribution of time spent in flight by delivered messages to latency.log
+ */
+void EmulNet::printDelayStats() {
+	const double pcts[] = { 0.5, 0.9, 0.99, 0.999 };
+	long total = 0, sum = 0, seen = 0;
+	unsigned int i, p = 0;
+	vector<long> hist;
+
+	// sum up the histograms of all receivers
+	for ( i = 0; i < delayHist.size(); i++ ) {
+		if ( delayHist[i].size() > hist.size() ) {
+			hist.resize(delayHist[i].size(), 0);
+		}
+		for ( unsigned int d = 0; d < delayHist[i].size(); d++ ) {
+			hist[d] += delayHist[i][d];
+		}
+	}
+
+	FILE* file = fopen("latency.log", "w+");
+
+	for ( i = 0; i < hist.size(); i++ ) {
+		total += hist[i];
+		sum += hist[i] * i;
+	}
+	fprintf(file, "delivered %ld mean %.3f max %d\n", total, total ? (double) sum / total : 0.0, (int) hist.size() - 1);
+
+	for ( i = 0; i < hist.size() && p < sizeof(pcts) / sizeof(pcts[0]); i++ ) {
+		seen += hist[i];
+		while ( p < sizeof(pcts) / sizeof(pcts[0]) && seen >= pcts[p] * total ) {
+			fprintf(file, "p%g %d\n", pcts[p] * 100, i);
+			p++;
+		}
+	}
+
+	for ( i = 0; i < hist.size(); i++ ) {
+		if ( hist[i] ) {
+			fprintf(file, "delay %4d count %8ld\n", i, hist[i]);
+		}
+	}
+
+	fclose(file);
+}
+
+/**
+ * FUNCTION NAME: sentBetween
+ *
+ * DESCRIPTION: Messages sent by all nodes in the time units [from, to)
+ */
+long EmulNet::sentBetween(int from, int to) {
+	long total = 0;
+	for ( int i = 1; i <= par->EN_GPSZ; i++ ) {
+		for ( int j = max(from, 0); j < to; j++ ) {
+			total += sent_msgs.get(i, j);
+		}
+	}
+	return total;
+}
+
+/**
+ * FUNCTION NAME: printFaultStats
+ *
+ * DESCRIPTION: Write what every injected fault dropped and the traffic around it to faults.log.
+ * 				The per time unit send counts after a heal show how long re-replication takes
+ * 				and what it costs.
+ */
+void EmulNet::printFaultStats() {
+	static const char *names[] = { "PARTITION", "CUT", "LINK_DROP" };
+
+	FILE* file = fopen("faults.log", "w+");
+
+	for ( int i = 0; i < faults.getNumFaults(); i++ ) {
+		FaultSpec &fault = par->FAULTS[i];
+		fprintf(file, "fault %d %s start %d heal %d dropped %ld sent_before %ld sent_during %ld\n", i, names[fault.type], fault.start, fault.end, faults.getDropped(i),
+				sentBetween(fault.start - FAULT_REPORT_WINDOW, fault.start),
+				sentBetween(fault.start, fault.end < 0 ? par->getcurrtime() : fault.end));
+		if ( fault.end < 0 || fault.end >= par->getcurrtime() ) {
+			continue;
+		}
+		fprintf(file, "  after heal:");
+		for ( int t = fault.end; t < fault.end + FAULT_REPORT_WINDOW && t < par->getcurrtime(); t++ ) {
+			fprintf(file, " %ld", sentBetween(t, t + 1));
+		}
+		fprintf(file, "\n");
+	}
+
+	fclose(file);
 }
 
 /**
@@ -184,13 +690,34 @@ int EmulNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct ti
 int EmulNet::ENcleanup() {
 	emulnet.nextid=0;
 	int i, j;
+
+	capture.close();
 	int sent_total, recv_total;
 
 	FILE* file = fopen("msgcount.log", "w+");
 
-	while(emulnet.currbuffsize > 0) {
-		free(emulnet.buff[--emulnet.currbuffsize]);
+	for ( i = 0; i < (int) emulnet.mailbox.size(); i++ ) {
+		en_mailbox &mailbox = emulnet.mailbox[i];
+		collect(mailbox);
+		while ( !mailbox.due.empty() ) {
+			ENrelease(mailbox.due.top().msg + 1);
+			mailbox.due.pop();
+		}
+	}
+	emulnet.currbuffsize = 0;
+	for ( i = 0; i < (int) emulnet.senders.size(); i++ ) {
+		en_sender &sender = emulnet.senders[i];
+		for ( int c = 0; c < EN_CHANNELS; c++ ) {
+			while ( !sender.backlog[c].sends.empty() ) {
+				ENrelease(sender.backlog[c].sends.front().msg + 1);
+				sender.backlog[c].sends.pop_front();
+			}
+			sender.backlog[c].waiting.clear();
+			sender.dueAt[c].clear();
+			sender.inFlight[c] = 0;
+		}
 	}
+	emulnet.backlogged = 0;
 
 	for ( i = 1; i <= par->EN_GPSZ; i++ ) {
 		fprintf(file, "node %3d ", i);
@@ -199,22 +726,36 @@ int EmulNet::ENcleanup() {
 
 		for (j = 0; j < par->getcurrtime(); j++) {
 
-			sent_total += sent_msgs[i][j];
-			recv_total += recv_msgs[i][j];
+			int sent = sent_msgs.get(i, j);
+			int recv = recv_msgs.get(i, j);
+			sent_total += sent;
+			recv_total += recv;
 			if (i != 67) {
-				fprintf(file, " (%4d, %4d)", sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, " (%4d, %4d)", sent, recv);
 				if (j % 10 == 9) {
 					fprintf(file, "\n         ");
 				}
 			}
 			else {
-				fprintf(file, "special %4d %4d %4d\n", j, sent_msgs[i][j], recv_msgs[i][j]);
+				fprintf(file, "special %4d %4d %4d\n", j, sent, recv);
 			}
 		}
 		fprintf(file, "\n");
-		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n\n", i, sent_total, recv_total);
+		fprintf(file, "node %3d sent_total %6u  recv_total %6u\n", i, sent_total, recv_total);
+		en_sender &sender = emulnet.getSender(i);
+		fprintf(file, "node %3d deferred %6ld  dropped %6ld\n\n", i, sender.deferred, sender.dropped);
 	}
 
 	fclose(file);
+
+	file = fopen("msgpool.log", "w+");
+	pool.printStats(file);
+	fclose(file);
+
+	printDelayStats();
+	printTrafficStats();
+	if ( faults.isEnabled() ) {
+		printFaultStats();
+	}
 	return 0;
 }
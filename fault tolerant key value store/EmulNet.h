@@ -7,16 +7,46 @@
 #ifndef _EMULNET_H_
 #define _EMULNET_H_
 
-#define MAX_NODES 1000
-#define MAX_TIME 3600
 #define ENBUFFSIZE 30000
+// deferred sends a node may have waiting for credits before further sends are dropped
+#define EN_BACKLOG_LIMIT 5000
+// time units of traffic reported before a fault starts and after it heals
+#define FAULT_REPORT_WINDOW 50
 
 #include "stdincludes.h"
 #include "Params.h"
 #include "Member.h"
+#include "MsgPool.h"
+#include "LinkModel.h"
+#include "MsgCapture.h"
+#include "FaultInjector.h"
+#include "MpscQueue.h"
 
 using namespace std;
 
+/**
+ * Logical channels sharing the network, every node has a mailbox on each
+ */
+enum ENChannel {
+	// membership protocol traffic, consumed into mp1q
+	MP1_CHANNEL,
+	// key value store traffic, consumed into mp2q
+	MP2_CHANNEL,
+	EN_CHANNELS
+};
+
+/**
+ * Outcome of a send for one destination
+ */
+enum SendStatus {
+	// queued in the destination mailbox
+	EN_SENT,
+	// accepted, but waits in the sender backlog until the sender has credit again
+	EN_DEFERRED,
+	// lost: dropped by the network, a fault, or the sender backlog is full
+	EN_DROPPED
+};
+
 /**
  * Struct Name: en_msg
  */
@@ -25,29 +55,134 @@ typedef struct en_msg {
 	int size;
 	// Source node
 	Address from;
-	// Destination node
+	// Destination node, the first one of a multicast
 	Address to;
+	// Channel the message travels on
+	int channel;
+	// Number of receivers that have not released this buffer yet
+	long refs;
 }en_msg;
 
+/**
+ * Struct Name: en_pending
+ *
+ * DESCRIPTION: A message waiting in a mailbox until its delivery time
+ */
+typedef struct en_pending {
+	// Time at which the message becomes visible to the destination
+	int deliverAt;
+	// Time at which the message was sent
+	int sentAt;
+	// Time at which it left the sender backlog for the network, sentAt unless it was deferred
+	int enteredAt;
+	// Send order, keeps messages due at the same time FIFO
+	long seq;
+	en_msg *msg;
+	bool operator > (const en_pending &another) const {
+		if ( deliverAt != another.deliverAt ) {
+			return deliverAt > another.deliverAt;
+		}
+		return seq > another.seq;
+	}
+}en_pending;
+
+/**
+ * Struct Name: en_inbound
+ *
+ * DESCRIPTION: A message on its way into a mailbox, linked into the inbox by next
+ */
+typedef struct en_inbound {
+	atomic<en_inbound *> next;
+	en_pending pending;
+}en_inbound;
+
+/**
+ * Struct Name: en_mailbox
+ *
+ * DESCRIPTION: Mailbox of one node. Senders on any thread push into inbox without locking,
+ * 				the node itself moves what arrived into due when it receives, so due is only
+ * 				ever touched by the thread running that node.
+ */
+typedef struct en_mailbox {
+	MpscQueue<en_inbound> inbox;
+	priority_queue< en_pending, vector<en_pending>, greater<en_pending> > due;
+}en_mailbox;
+
+/**
+ * Struct Name: en_deferred
+ *
+ * DESCRIPTION: A send waiting in the sender backlog for credit
+ */
+typedef struct en_deferred {
+	int dst;
+	int sentAt;
+	en_msg *msg;
+}en_deferred;
+
+/**
+ * Struct Name: en_backlog
+ *
+ * DESCRIPTION: Deferred sends of one sender on one channel, oldest first. Order only has to hold
+ * 				between messages to the same destination, so a new send waits only if an older one
+ * 				to its destination is still queued; waiting counts those by destination.
+ */
+typedef struct en_backlog {
+	deque<en_deferred> sends;
+	map<int, int> waiting;
+}en_backlog;
+
+/**
+ * Struct Name: en_sender
+ *
+ * DESCRIPTION: Flow control state of one sender. Credits and backlog are kept per channel,
+ * 				so a bulk transfer on one channel never holds up the traffic of the other.
+ * 				A message holds its credit until the end of the time unit it falls due in,
+ * 				whether or not its destination is still alive to take it, see ENtick.
+ */
+typedef struct en_sender {
+	// Messages of this sender on each channel that still hold a credit
+	atomic<int> inFlight[EN_CHANNELS];
+	// How many of them fall due at each time
+	map<int, int> dueAt[EN_CHANNELS];
+	// Sends that had to wait for credit
+	long deferred;
+	// Sends lost because the backlog was full
+	long dropped;
+	en_backlog backlog[EN_CHANNELS];
+	en_sender(): deferred(0), dropped(0) {
+		for ( int c = 0; c < EN_CHANNELS; c++ ) {
+			inFlight[c] = 0;
+		}
+	}
+}en_sender;
+
 /**
  * Class Name: EM
+ *
+ * DESCRIPTION: Messages in flight are kept in one mailbox per destination and channel, indexed by
+ * 				the emulnet id of the destination address and ordered by delivery time.
+ * 				Flow control state is kept per sender, indexed the same way.
+ * 				Both live in deques so they stay in place as the network grows; the
+ * 				state shared by all senders is atomic, so nodes may send from any thread.
+ * 				Mailboxes hold live messages and are not copied with the rest.
  */
 class EM {
 public:
 	int nextid;
-	int currbuffsize;
+	atomic<int> currbuffsize;
 	int firsteltindex;
-	en_msg* buff[ENBUFFSIZE];
-	EM() {}
+	atomic<long> nextseq;
+	// Total number of sends waiting in sender backlogs
+	atomic<int> backlogged;
+	deque<en_mailbox> mailbox;
+	deque<en_sender> senders;
+	EM(): nextseq(0), backlogged(0) {}
 	EM& operator = (EM &anotherEM) {
 		this->nextid = anotherEM.getNextId();
 		this->currbuffsize = anotherEM.getCurrBuffSize();
 		this->firsteltindex = anotherEM.getFirstEltIndex();
-		int i = this->currbuffsize;
-		while (i > 0) {
-			this->buff[i] = anotherEM.buff[i];
-			i--;
-		}
+		this->nextseq = anotherEM.nextseq.load();
+		this->backlogged = anotherEM.backlogged.load();
 		return *this;
 	}
 	int getNextId() {
@@ -59,6 +194,21 @@ public:
 	int getFirstEltIndex() {
 		return firsteltindex;
 	}
+	en_mailbox &getMailbox(int id, int channel) {
+		assert(id >= 0 && channel >= 0 && channel < EN_CHANNELS);
+		int idx = id * EN_CHANNELS + channel;
+		if ( idx >= (int) mailbox.size() ) {
+			mailbox.resize(idx + 1);
+		}
+		return mailbox[idx];
+	}
+	en_sender &getSender(int id) {
+		assert(id >= 0);
+		if ( id >= (int) senders.size() ) {
+			senders.resize(id + 1);
+		}
+		return senders[id];
+	}
 	void setNextId(int nextid) {
 		this->nextid = nextid;
 	}
@@ -71,6 +221,97 @@ public:
 	virtual ~EM() {}
 };
 
+/**
+ * Class Name: MsgCounter
+ *
+ * DESCRIPTION: Per node, per time unit message counter.
+ * 				Each node owns an array that only grows up to the last time it was counted at,
+ * 				so memory follows the number of nodes and the length of the run
+ */
+class MsgCounter {
+public:
+	vector< vector<int> > counts;
+	MsgCounter() {}
+	void init(int nodes) {
+		counts.assign(nodes + 1, vector<int>());
+	}
+	void incr(int node, int time) {
+		assert(node >= 0 && time >= 0);
+		if ( node >= (int) counts.size() ) {
+			counts.resize(node + 1);
+		}
+		vector<int> &perTime = counts[node];
+		if ( time >= (int) perTime.size() ) {
+			perTime.resize(time + 1, 0);
+		}
+		perTime[time]++;
+	}
+	int get(int node, int time) {
+		if ( node >= (int) counts.size() || time >= (int) counts[node].size() ) {
+			return 0;
+		}
+		return counts[node][time];
+	}
+	virtual ~MsgCounter() {}
+};
+
+/**
+ * Maps a payload to the index of its message type, or a negative value if it is not recognized
+ */
+typedef int (*en_classifier)(char *data, int size);
+
+/**
+ * Struct Name: en_traffic
+ *
+ * DESCRIPTION: Messages and payload bytes of one type a node sent and received in one time unit
+ */
+typedef struct en_traffic {
+	int sentMsgs;
+	int recvMsgs;
+	long sentBytes;
+	long recvBytes;
+}en_traffic;
+
+/**
+ * Class Name: TrafficCounter
+ *
+ * DESCRIPTION: Per node, per time unit, per message type traffic counter.
+ * 				Grows like MsgCounter, with one cell per message type in every time unit.
+ */
+class TrafficCounter {
+public:
+	int ntypes;
+	vector< vector<en_traffic> > cells;
+	TrafficCounter(): ntypes(1) {}
+	void init(int nodes, int ntypes) {
+		this->ntypes = ntypes;
+		cells.assign(nodes + 1, vector<en_traffic>());
+	}
+	en_traffic &cell(int node, int time, int type) {
+		assert(node >= 0 && time >= 0 && type >= 0 && type < ntypes);
+		if ( node >= (int) cells.size() ) {
+			cells.resize(node + 1);
+		}
+		vector<en_traffic> &perTime = cells[node];
+		if ( (time + 1) * ntypes > (int) perTime.size() ) {
+			en_traffic zero = { 0, 0, 0, 0 };
+			perTime.resize((time + 1) * ntypes, zero);
+		}
+		return perTime[time * ntypes + type];
+	}
+	void sent(int node, int time, int type, int bytes) {
+		en_traffic &c = cell(node, time, type);
+		c.sentMsgs++;
+		c.sentBytes += bytes;
+	}
+	void received(int node, int time, int type, int bytes) {
+		en_traffic &c = cell(node, time, type);
+		c.recvMsgs++;
+		c.recvBytes += bytes;
+	}
+	virtual ~TrafficCounter() {}
+};
+
 /**
  * CLASS NAME: EmulNet
  *
@@ -78,22 +319,71 @@ public:
  */
 class EmulNet
 { 	
-private:
+protected:
 	Params* par;
-	int sent_msgs[MAX_NODES + 1][MAX_TIME];
-	int recv_msgs[MAX_NODES + 1][MAX_TIME];
+	MsgCounter sent_msgs;
+	MsgCounter recv_msgs;
+	// traffic by message type. Every channel has its own types, laid out one channel after
+	// the other in typeNames; the last type of a channel collects what its classifier does
+	// not recognize
+	TrafficCounter traffic;
+	vector<string> channelLabels;
+	vector< vector<string> > channelTypes;
+	vector<en_classifier> classify;
+	vector<int> typeBase;
+	vector<string> typeNames;
+	vector<int> typeChannel;
+	void layoutTypes();
+	int msgType(int channel, char *data, int size);
 	int enInited;
 	EM emulnet;
+	MsgPool pool;
+	FaultInjector faults;
+	// outcome of the last send made by the calling thread
+	static thread_local int lastSendStatus;
+	// trace of every accepted send, when capturing
+	CaptureWriter capture;
+	// true while a trace is replayed: the handlers' own sends go nowhere
+	bool replaying;
+	bool hasCredit(int src, int channel, int extra);
+	void dispatch(en_msg *em, int src, int dst, int sentAt);
+	void collect(en_mailbox &mailbox);
+	void drainBacklog(int src, int channel);
+	long sentBetween(int from, int to);
+	void printFaultStats();
+private:
+	LinkModel link;
+	// per receiver, number of delivered messages by how many time units they spent in flight
+	vector< vector<long> > delayHist;
+	void printDelayStats();
+	void printTrafficStats();
 public:
  	EmulNet(Params *p);
  	EmulNet(EmulNet &anotherEmulNet);
  	EmulNet& operator = (EmulNet &anotherEmulNet);
  	virtual ~EmulNet();
-	void *ENinit(Address *myaddr, short port);
-	int ENsend(Address *myaddr, Address *toaddr, string data);
-	int ENsend(Address *myaddr, Address *toaddr, char *data, int size);
-	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue);
-	int ENcleanup();
+	virtual void *ENinit(Address *myaddr, short port);
+	int ENsend(Address *myaddr, Address *toaddr, string data, int channel);
+	int ENsend(Address *myaddr, Address *toaddr, char *data, int size, int channel);
+	int ENsendMulti(Address *myaddr, vector<Address> &toaddrs, string data, int channel);
+	int ENsendMulti(Address *myaddr, vector<Address> &toaddrs, char *data, int size, int channel);
+	virtual int ENsendMulti(Address *myaddr, Address *toaddrs, int count, char *data, int size, int channel, int *status = NULL);
+	int getLastSendStatus() {
+		return lastSendStatus;
+	}
+	virtual int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue, int channel);
+	virtual void ENrelease(void *data);
+	bool setCapture(const char *path);
+	void setMsgTypes(int channel, string label, const vector<string> &names, en_classifier classify);
+	void setReplaying(bool replaying) {
+		this->replaying = replaying;
+	}
+	int ENdeliver(int from, Address *toaddr, char *data, int size, int channel);
+	MsgPool *getMsgPool() {
+		return &pool;
+	}
+	void ENtick();
+	virtual int ENcleanup();
 };
 
 #endif /* _EMULNET_H_ */
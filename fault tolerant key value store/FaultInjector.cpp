@@ -0,0 +1,125 @@
+/**********************************
+ * FILE NAME: FaultInjector.cpp
+ *
+ * DESCRIPTION: Definition of the network fault injector
+ **********************************/
+
+#include "FaultInjector.h"
+
+/**
+ * Constructor
+ */
+FaultInjector::FaultInjector(Params *p): par(p) {
+	unsigned int i, j;
+	inA.resize(par->FAULTS.size());
+	inB.resize(par->FAULTS.size());
+	dropped.assign(par->FAULTS.size(), 0);
+
+	for ( i = 0; i < par->FAULTS.size(); i++ ) {
+		FaultSpec &fault = par->FAULTS[i];
+		for ( j = 0; j < fault.groupA.size(); j++ ) {
+			if ( fault.groupA[j] >= (int) inA[i].size() ) {
+				inA[i].resize(fault.groupA[j] + 1, false);
+			}
+			inA[i][fault.groupA[j]] = true;
+		}
+		for ( j = 0; j < fault.groupB.size(); j++ ) {
+			if ( fault.groupB[j] >= (int) inB[i].size() ) {
+				inB[i].resize(fault.groupB[j] + 1, false);
+			}
+			inB[i][fault.groupB[j]] = true;
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: isEnabled
+ *
+ * DESCRIPTION: True if the test case has a fault schedule
+ */
+bool FaultInjector::isEnabled() {
+	return !dropped.empty();
+}
+
+/**
+ * FUNCTION NAME: isActive
+ *
+ * DESCRIPTION: True if fault idx is in effect at the given time
+ */
+bool FaultInjector::isActive(int idx, int time) {
+	FaultSpec &fault = par->FAULTS[idx];
+	return time >= fault.start && (fault.end < 0 || time < fault.end);
+}
+
+/**
+ * FUNCTION NAME: isMember
+ *
+ * DESCRIPTION: Membership test on a group bitmap
+ */
+bool FaultInjector::isMember(vector<bool> &group, int id) {
+	return id >= 0 && id < (int) group.size() && group[id];
+}
+
+/**
+ * FUNCTION NAME: matches
+ *
+ * DESCRIPTION: True if fault idx applies to traffic from src to dst
+ */
+bool FaultInjector::matches(FaultSpec &fault, int idx, int src, int dst) {
+	if ( fault.type == PARTITION_FAULT ) {
+		bool srcA = isMember(inA[idx], src);
+		bool dstA = isMember(inA[idx], dst);
+		if ( fault.groupB.empty() ) {
+			// groupA is cut off from everybody else
+			return srcA != dstA;
+		}
+		return (srcA && isMember(inB[idx], dst)) || (dstA && isMember(inB[idx], src));
+	}
+	return (fault.from == 0 || fault.from == src) && (fault.to == 0 || fault.to == dst);
+}
+
+/**
+ * FUNCTION NAME: blocks
+ *
+ * DESCRIPTION: Decide whether a message from src to dst sent at time is lost to an injected fault
+ *
+ * RETURNS:
+ * true if the message must be dropped
+ */
+bool FaultInjector::blocks(int src, int dst, int time) {
+	for ( unsigned int i = 0; i < par->FAULTS.size(); i++ ) {
+		FaultSpec &fault = par->FAULTS[i];
+		if ( !isActive(i, time) || !matches(fault, i, src, dst) ) {
+			continue;
+		}
+		if ( fault.dropProb >= 1 || (rand() % 10000) < (int) (fault.dropProb * 10000) ) {
+			dropped[i]++;
+			return true;
+		}
+	}
+	return false;
+}
+
+/**
+ * FUNCTION NAME: blocksSince
+ *
+ * DESCRIPTION: Decide whether a message from src to dst that blocks let through at time from is lost
+ * 				to a fault that struck after that, by time to, while the message was still on its way.
+ * 				Faults in effect at from were already applied to it and are not applied again.
+ *
+ * RETURNS:
+ * true if the message must be dropped
+ */
+bool FaultInjector::blocksSince(int src, int dst, int from, int to) {
+	for ( unsigned int i = 0; i < par->FAULTS.size(); i++ ) {
+		FaultSpec &fault = par->FAULTS[i];
+		if ( fault.start <= from || fault.start > to || !matches(fault, i, src, dst) ) {
+			continue;
+		}
+		if ( fault.dropProb >= 1 || (rand() % 10000) < (int) (fault.dropProb * 10000) ) {
+			dropped[i]++;
+			return true;
+		}
+	}
+	return false;
+}
@@ -0,0 +1,43 @@
+/**********************************
+ * FILE NAME: FaultInjector.h
+ *
+ * DESCRIPTION: Header file of the network fault injector
+ **********************************/
+
+#ifndef FAULTINJECTOR_H_
+#define FAULTINJECTOR_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+
+/**
+ * CLASS NAME: FaultInjector
+ *
+ * DESCRIPTION: Plays the fault schedule of the test case (Params::FAULTS) against
+ * 				the traffic of a transport and counts what every fault dropped
+ */
+class FaultInjector {
+private:
+	Params *par;
+	// per fault, membership of groupA / groupB indexed by emulnet id
+	vector< vector<bool> > inA;
+	vector< vector<bool> > inB;
+	vector<long> dropped;
+	bool isMember(vector<bool> &group, int id);
+	bool matches(FaultSpec &fault, int idx, int src, int dst);
+public:
+	FaultInjector(Params *p);
+	bool isEnabled();
+	bool isActive(int idx, int time);
+	bool blocks(int src, int dst, int time);
+	bool blocksSince(int src, int dst, int from, int to);
+	int getNumFaults() {
+		return dropped.size();
+	}
+	long getDropped(int idx) {
+		return dropped[idx];
+	}
+	virtual ~FaultInjector() {}
+};
+
+#endif /* FAULTINJECTOR_H_ */
@@ -8,6 +8,11 @@
 # RUN PROCEDURE:
 # $ chmod +x KVStoreGrader.sh
 # $ ./KVStoreGrader.sh
+#
+# The same tests with every node limited to a few messages in flight:
+# $ TESTCASES=./testcases/lowcredit ./KVStoreGrader.sh
+# or with JOINREQ and JOINREP lost while the group forms:
+# $ TESTCASES=./testcases/lossyjoin ./KVStoreGrader.sh
 #################################################
 
 function contains () {
@@ -33,6 +38,7 @@ verbose=$(contains "-v" "$@")
 ###
 SUCCESS=0
 FAILURE=-1
+TESTCASES="${TESTCASES:-./testcases}"
 RF=3
 RFPLUSONE=4
 CREATE_OPERATION="CREATE OPERATION"
@@ -69,7 +75,7 @@ then
     	echo "COMPILATION ERROR !!!"
     	exit
     fi
-    ./Application ./testcases/create.conf > /dev/null 2>&1
+    ./Application ${TESTCASES}/create.conf > /dev/null 2>&1
 else
 	make clean
 	make
@@ -78,7 +84,7 @@ else
     	echo "COMPILATION ERROR !!!"
     	exit
     fi
-	./Application ./testcases/create.conf
+	./Application ${TESTCASES}/create.conf
 fi
 
 echo "TEST 1: Create 3 replicas of every key"
@@ -139,7 +145,7 @@ then
     	echo "COMPILATION ERROR !!!"
     	exit
     fi
-    ./Application ./testcases/delete.conf > /dev/null 2>&1
+    ./Application ${TESTCASES}/delete.conf > /dev/null 2>&1
 else
 	make clean
 	make
@@ -148,7 +154,7 @@ else
     	echo "COMPILATION ERROR !!!"
     	exit
     fi
-	./Application ./testcases/delete.conf
+	./Application ${TESTCASES}/delete.conf
 fi
 
 echo "TEST 1: Delete 3 replicas of every key"
@@ -237,7 +243,7 @@ then
     	echo "COMPILATION ERROR !!!"
     	exit
     fi
-    ./Application ./testcases/read.conf > /dev/null 2>&1
+    ./Application ${TESTCASES}/read.conf > /dev/null 2>&1
 else
 	make clean
 	make
@@ -246,7 +252,7 @@ else
     	echo "COMPILATION ERROR !!!"
     	exit
     fi
-	./Application ./testcases/read.conf
+	./Application ${TESTCASES}/read.conf
 fi
 
 read_operations=`grep -i "${READ_OPERATION}" dbg.log  | cut -d" " -f3 | tr -s ']' ' '  | tr -s '[' ' ' | sort`
@@ -445,7 +451,7 @@ then
     	echo "COMPILATION ERROR !!!"
     	exit
     fi
-    ./Application ./testcases/update.conf > /dev/null 2>&1
+    ./Application ${TESTCASES}/update.conf > /dev/null 2>&1
 else
 	make clean
 	make
@@ -454,7 +460,7 @@ else
     	echo "COMPILATION ERROR !!!"
     	exit
     fi
-	./Application ./testcases/update.conf
+	./Application ${TESTCASES}/update.conf
 fi
 
 update_operations=`grep -i "${UPDATE_OPERATION}" dbg.log  | cut -d" " -f3 | tr -s ']' ' '  | tr -s '[' ' ' | sort`
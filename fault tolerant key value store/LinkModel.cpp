@@ -0,0 +1,85 @@
+/**********************************
+ * FILE NAME: LinkModel.cpp
+ *
+ * DESCRIPTION: Definition of the EmulNet link model
+ **********************************/
+
+#include "LinkModel.h"
+
+/**
+ * Constructor
+ */
+LinkModel::LinkModel(Params *p): par(p), rng(rand()) {
+	for ( unsigned int i = 0; i < par->LINKS.size(); i++ ) {
+		LinkSpec &link = par->LINKS[i];
+		links[make_pair(link.from, link.to)] = link;
+	}
+}
+
+/**
+ * FUNCTION NAME: isEnabled
+ *
+ * DESCRIPTION: True if any link can hold a message back
+ */
+bool LinkModel::isEnabled() {
+	return par->LINK_LATENCY > 0 || par->LINK_JITTER > 0 || par->NODE_BANDWIDTH > 0 || !links.empty();
+}
+
+/**
+ * FUNCTION NAME: sampleDelay
+ *
+ * DESCRIPTION: Draw one link delay from the latencyDIST dist
+ */
+int LinkModel::sampleDelay(int latency, int jitter, int dist) {
+	double delay = latency;
+
+	if ( jitter > 0 ) {
+		switch ( dist ) {
+			case UNIFORM_LATENCY: {
+				uniform_int_distribution<int> spread(-jitter, jitter);
+				delay += spread(rng);
+				break;
+			}
+			case EXP_LATENCY: {
+				// long tail: the mean of the extra delay is jitter
+				exponential_distribution<double> spread(1.0 / jitter);
+				delay += spread(rng);
+				break;
+			}
+			default:
+				break;
+		}
+	}
+
+	return delay < 0 ? 0 : (int) delay;
+}
+
+/**
+ * FUNCTION NAME: deliveryTime
+ *
+ * DESCRIPTION: Time at which a message of size bytes sent from src to dst at time now is delivered
+ */
+int LinkModel::deliveryTime(int src, int dst, int size, int now) {
+	int latency = par->LINK_LATENCY;
+	int jitter = par->LINK_JITTER;
+	int dist = par->LINK_DIST;
+	double sent = now;
+
+	map< pair<int, int>, LinkSpec >::iterator link = links.find(make_pair(src, dst));
+	if ( link != links.end() ) {
+		latency = link->second.latency;
+		jitter = link->second.jitter;
+		dist = link->second.dist;
+	}
+
+	if ( par->NODE_BANDWIDTH > 0 ) {
+		if ( src >= (int) uplinkFree.size() ) {
+			uplinkFree.resize(src + 1, 0);
+		}
+		double start = max((double) now, uplinkFree[src]);
+		uplinkFree[src] = start + (double) size / par->NODE_BANDWIDTH;
+		sent = uplinkFree[src];
+	}
+
+	return (int) floor(sent) + sampleDelay(latency, jitter, dist);
+}
@@ -0,0 +1,37 @@
+/**********************************
+ * FILE NAME: LinkModel.h
+ *
+ * DESCRIPTION: Header file of the EmulNet link model
+ **********************************/
+
+#ifndef LINKMODEL_H_
+#define LINKMODEL_H_
+
+#include "stdincludes.h"
+#include "Params.h"
+#include <random>
+
+/**
+ * CLASS NAME: LinkModel
+ *
+ * DESCRIPTION: Decides when a message sent now becomes visible to its destination.
+ * 				Every link adds a delay drawn from its latency distribution, and each
+ * 				sender can only put NODE_BANDWIDTH bytes per time unit on the wire, so
+ * 				back to back sends from the same node queue up behind each other.
+ */
+class LinkModel {
+private:
+	Params *par;
+	default_random_engine rng;
+	map< pair<int, int>, LinkSpec > links;
+	// time at which each sender's uplink is free again
+	vector<double> uplinkFree;
+	int sampleDelay(int latency, int jitter, int dist);
+public:
+	LinkModel(Params *p);
+	bool isEnabled();
+	int deliveryTime(int src, int dst, int size, int now);
+	virtual ~LinkModel() {}
+};
+
+#endif /* LINKMODEL_H_ */
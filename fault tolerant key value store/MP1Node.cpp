@@ -18,7 +18,7 @@
  * You can add new members to the class if you think it
  * is necessary for your logic to work
  */
-MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Address *address) {
+MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Address *address): tombstones(TOMBSTONE_BUCKETS, TREMOVE) {
 	for( int i = 0; i < 6; i++ ) {
 		NULLADDR[i] = 0;
 	}
@@ -27,6 +27,16 @@ MP1Node::MP1Node(Member *member, Params *params, EmulNet *emul, Log *log, Addres
 	this->log = log;
 	this->par = params;
 	this->memberNode->addr = *address;
+	this->localTime = 0;
+	this->joinAttempts = 0;
+	this->joinSentAt = 0;
+	int slowest = this->par->LINK_LATENCY + this->par->LINK_JITTER;
+	for (LinkSpec &link : this->par->LINKS) {
+		slowest = max(slowest, link.latency + link.jitter);
+	}
+	this->joinTimeout = max(JOIN_TIMEOUT, 2 * slowest + 2);
+	this->gossipSeq = 0;
+	this->peerPoolStale = true;
 }
 
 /**
@@ -45,7 +55,7 @@ int MP1Node::recvLoop() {
     	return false;
     }
     else {
-    	return emulNet->ENrecv(&(memberNode->addr), enqueueWrapper, NULL, 1, &(memberNode->mp1q));
+    	return emulNet->ENrecv(&(memberNode->addr), enqueueWrapper, NULL, 1, &(memberNode->mp1q), MP1_CHANNEL);
     }
 }
 
@@ -59,6 +69,34 @@ int MP1Node::enqueueWrapper(void *env, char *buff, int size) {
 	return q.enqueue((queue<q_elt> *)env, (void *)buff, size);
 }
 
+/**
+ * FUNCTION NAME: msgTypeOf
+ *
+ * DESCRIPTION: Message type of an MP1 payload, for the per type traffic accounting of EmulNet
+ */
+int MP1Node::msgTypeOf(char *data, int size) {
+	if ( size < (int) sizeof(MessageHdr) ) {
+		return -1;
+	}
+	return ((MessageHdr *)data)->msgType;
+}
+
+/**
+ * FUNCTION NAME: msgTypeNames
+ *
+ * DESCRIPTION: Names of the MP1 message types, indexed by MsgTypes
+ */
+vector<string> MP1Node::msgTypeNames() {
+	vector<string> names;
+	names.push_back("JOINREQ");
+	names.push_back("JOINREP");
+	names.push_back("PINGHEARTBEAT");
+	names.push_back("PING");
+	names.push_back("ACK");
+	names.push_back("PINGREQ");
+	return names;
+}
+
 /**
  * FUNCTION NAME: nodeStart
  *
@@ -115,6 +153,18 @@ int MP1Node::initThisNode(Address *joinaddr) {
 	memberNode->heartbeat = 0;
 	memberNode->pingCounter = TFAIL;
 	memberNode->timeOutCounter = TREMOVE;
+    gossipSeq = 0;
+    gossipedUpTo.clear();
+    probeOrder.clear();
+    probeNext = 0;
+    probeTarget = -1;
+    probeSeq = 0;
+    probeStart = 0;
+    probeAcked = true;
+    probeIndirect = false;
+    suspectedAt.clear();
+    swimUpdates.clear();
+    tombstones.clear();
     initMemberListTable(memberNode);
 
     return 0;
@@ -138,7 +188,6 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
 #endif
         memberNode->inGroup = true;
         log->logNodeAdd(&memberNode->addr, &memberNode->addr);
-        this->n_members = 1;
     }
     else {
         size_t msgsize = sizeof(MessageHdr) + sizeof(HeartBeatEntry);
@@ -149,6 +198,8 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
         memcpy(hb_entry->addr, &memberNode->addr.addr, sizeof(memberNode->addr.addr));
         
         hb_entry->heartbeat_no = memberNode->heartbeat;
+        hb_entry->state = MEMBER_ALIVE;
+        hb_entry->incarnation = 0;
         
 
 #ifdef DEBUGLOG
@@ -157,8 +208,9 @@ int MP1Node::introduceSelfToGroup(Address *joinaddr) {
 #endif
 
         // send JOINREQ message to introducer member
-        emulNet->ENsend(&memberNode->addr, joinaddr, (char *)msg, msgsize);
-        this->n_members = 1;
+        emulNet->ENsend(&memberNode->addr, joinaddr, (char *)msg, msgsize, MP1_CHANNEL);
+        this->joinAttempts++;
+        this->joinSentAt = this->localTime;
         free(msg);
     }
 
@@ -193,7 +245,11 @@ void MP1Node::nodeLoop() {
     this->localTime++;
     if(memberNode->inGroup) {
         MemberListEntry &mle = memberNode->memberList[0];
-        mle.heartbeat++;
+        // SWIM learns who is alive from its probes, heartbeats are not gossiped
+        if (par->DETECTOR == HEARTBEAT_DETECTOR) {
+            mle.heartbeat++;
+            touch(&mle);
+        }
         mle.timestamp = localTime;
     }
     // Check my messages
@@ -201,6 +257,11 @@ void MP1Node::nodeLoop() {
 
     // Wait until you're in the group...
     if( !memberNode->inGroup ) {
+        // the introducer may not be up yet, or gone, or its reply lost: try the next one
+        if (this->localTime - this->joinSentAt >= this->joinTimeout) {
+            Address joinaddr = getJoinAddress();
+            introduceSelfToGroup(&joinaddr);
+        }
     	return;
     }
 
@@ -225,6 +286,7 @@ void MP1Node::checkMessages() {
     	size = memberNode->mp1q.front().size;
     	memberNode->mp1q.pop();
     	recvCallBack((void *)memberNode, (char *)ptr, size);
+    	emulNet->ENrelease(ptr);
     }
     return;
 }
@@ -241,54 +303,58 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
     {
         case JOINREQ: {
             HeartBeatEntry* entry = (HeartBeatEntry *) (hdr + 1);
-            assert(memberNode->addr == getJoinAddress());
+            // an introducer that has not joined itself yet has nothing to give, the joiner asks another
+            if (!memberNode->inGroup) {
+                break;
+            }
             int id = getId(entry);
             short port = getPort(entry);
-            int beat_no = get_heartbeat_no(entry);
-            MemberListEntry mem_entry(id, port, beat_no, this->localTime);
-            memberNode->memberList.push_back(mem_entry);
-            this->n_members++;
+            // a member back after it was declared dead starts above its tombstone
+            entry->incarnation = max(entry->incarnation, tombstones.incarnationOf(peerKey(id, port)) + 1);
+            // a retried JOINREQ finds the joiner already in the list
+            updateEntry(entry);
 
             Address sendaddr;
             memset(&sendaddr, 0, sizeof(Address));
             *(int *)(&sendaddr.addr) = id;
             *(short *)(&sendaddr.addr[4]) = port;
 
-            log->logNodeAdd(&memberNode->addr, &sendaddr);
-
-            // Send JOINREP
-            size_t msg_size = sizeof(MessageHdr) + sizeof(int) + this->n_members * sizeof(HeartBeatEntry);
-            MessageHdr *msg = (MessageHdr *) malloc(msg_size * sizeof(char));
-            msg->msgType = JOINREP;
-            int *n_entries = (int *) (msg + 1);
-            *n_entries = this->n_members;
-            HeartBeatEntry *entries = (HeartBeatEntry *) (n_entries + 1);
-            for (int i = 0; i < n_members; i++) {
-                MemberListEntry &mle = memberNode->memberList[i];
-                HeartBeatEntry entry;
-                init_entry(&entry, mle.getid(), mle.getport(), mle.getheartbeat());
-                memcpy(&entries[i], &entry, sizeof(HeartBeatEntry));
+            if (par->DETECTOR == SWIM_DETECTOR) {
+                swimEnqueue(peerKey(id, port), MEMBER_ALIVE, entry->incarnation);
             }
 
-            emulNet->ENsend(&memberNode->addr, &sendaddr , (char *)msg, msg_size);
-            free(msg);
+            // Send JOINREP, the snapshot goes in as many chunks as it takes, each one in address order
+            vector<Address> to(1, sendaddr);
+            vector<int> order = addressOrder();
+            sendEntries(to, order, 0, JOINREP);
             break;
         }
         case JOINREP: {
-            assert(!(memberNode->addr == getJoinAddress()));
-            int *n_enries = (int *) (hdr + 1);
-            HeartBeatEntry* entries = (HeartBeatEntry *)(n_enries + 1);
-            for (int i = 0; i < (*n_enries); i++) {
-                updateEntry(&entries[i]);
+            vector<HeartBeatEntry> entries;
+            if (!decodeEntries(hdr, size, entries)) {
+                break;
             }
+            mergeEntries(entries.data(), entries.size());
             memberNode->inGroup = true;
+            if (par->DETECTOR == SWIM_DETECTOR) {
+                // the introducer tells the others about us, this makes sure of it
+                MemberListEntry &self = memberNode->memberList[0];
+                swimEnqueue(peerKey(self.getid(), self.getport()), MEMBER_ALIVE, self.incarnation);
+            }
+            break;
         }
         case PINGHEARTBEAT: {
-            int *n_enries = (int *) (hdr + 1);
-            HeartBeatEntry* entries = (HeartBeatEntry *)(n_enries + 1);
-            for (int i = 0; i < (*n_enries); i++) {
-                updateEntry(&entries[i]);
+            vector<HeartBeatEntry> entries;
+            if (decodeEntries(hdr, size, entries)) {
+                mergeEntries(entries.data(), entries.size());
             }
+            break;
+        }
+        case PING:
+        case ACK:
+        case PINGREQ: {
+            swimRecv(hdr, size);
+            break;
         }
 
     }
@@ -297,98 +363,634 @@ bool MP1Node::recvCallBack(void *env, char *data, int size ) {
 /**
  * FUNCTION NAME: nodeLoopOps
  *
- * DESCRIPTION: Check if any node hasn't responded within a timeout period and then delete
- * 				the nodes
+ * DESCRIPTION: Move members along their states: a member that has gone quiet is suspected,
+ * 				a suspect that did not refute in time is declared dead, and the dead are
+ * 				moved to the tombstones
  * 				Propagate your membership list
  */
 void MP1Node::nodeLoopOps() {
 
+    tombstones.expire(this->localTime);
     if (memberNode->memberList.size() < 2) return;
 
 
-    vector<int> to_remove_indxs(0);
-    for (int i = 0; i < this->n_members; i++) {
-        MemberListEntry *mle = &memberNode->memberList[i];
-        if (mle->heartbeat != HeartBeat::FAILED && this->localTime - mle->gettimestamp() > TFAIL) {
-            mle->setheartbeat(HeartBeat::FAILED);
-            mle->settimestamp(this->localTime);
-        } 
-        else if (mle->heartbeat == HeartBeat::FAILED && this->localTime - mle->gettimestamp() > TREMOVE) {
-            to_remove_indxs.push_back(i);
+    // one compaction pass: entries that stay slide down over the removed ones, order is kept
+    vector<MemberListEntry> &list = memberNode->memberList;
+    int kept = 0;
+    long suspectTimeout = (par->DETECTOR == SWIM_DETECTOR) ? SWIM_SUSPECT_TIMEOUT : TSUSPECT;
+    int count = list.size();
+    for (int i = 0; i < count; i++) {
+        MemberListEntry *mle = &list[i];
+        long key = entryKey(*mle);
+        bool overdue = (par->PHI_THRESHOLD > 0) ? phi(mle) > par->PHI_THRESHOLD : this->localTime - mle->gettimestamp() > TFAIL;
+        if (par->DETECTOR == HEARTBEAT_DETECTOR && i > 0 && mle->state == MEMBER_ALIVE && overdue) {
+            suspect(key);
+        }
+        else if (i > 0 && mle->state == MEMBER_SUSPECT && this->localTime - suspectedAt[key] > suspectTimeout) {
+            setState(mle, MEMBER_DEAD);
+            if (par->DETECTOR == SWIM_DETECTOR) {
+                swimEnqueue(key, MEMBER_DEAD, mle->incarnation);
+            }
         }
+        // the dead, whether we declared them or heard of it, go to the tombstones right away
+        if (i > 0 && mle->state == MEMBER_DEAD) {
+            bury(mle);
+            continue;
+        }
+        if (kept != i) {
+            list[kept] = list[i];
+        }
+        kept++;
+    }
+    if (kept < count) {
+        list.resize(kept);
+        reindex();
     }
 
-    for (int i = 0; i < to_remove_indxs.size(); i++) {
-        int idx = to_remove_indxs[i] - i;
-        MemberListEntry &mle = *(memberNode->memberList.begin() + idx);
-        int id = mle.getid();
-        short port = mle.getport();
-        Address failedaddr;
-        memset(&failedaddr, 0, sizeof(Address));
-        *(int *)(&failedaddr.addr) = id;
-        *(short *)(&failedaddr.addr[4]) = port;
-        log->logNodeRemove(&memberNode->addr, &failedaddr);
-        memberNode->memberList.erase(memberNode->memberList.begin() + idx);
 
-        // char str[512];
-        // sprintf(str,"removed %d.%d.%d.%d:%d \n",  failedaddr.addr[0],failedaddr.addr[1],failedaddr.addr[2],failedaddr.addr[3], *(short*)&failedaddr.addr[4]);
 
-        // log->LOG(&memberNode->addr, str);
 
 
-        this->n_members--;
+    if (par->DETECTOR == SWIM_DETECTOR) {
+        swimLoopOps();
+        return;
+    }
+
+    // send ping to random neighbours
+
+    vector<Address> sendaddrs;
+    for (int i : pickPeers(PING_NBR_CNT, -1)) {
+        int id = memberNode->memberList[i].getid();
+        short port = memberNode->memberList[i].getport();
+        Address sendaddr;
+        memset(&sendaddr, 0, sizeof(Address));
+        *(int *)(&sendaddr.addr) = id;
+        *(short *)(&sendaddr.addr[4]) = port;
+        sendaddrs.push_back(sendaddr);
+    }
 
-        for (auto &me : memberNode->memberList) {
-            int id = me.getid();
-            short port = me.getport();
-            Address failedaddr;
-            memset(&failedaddr, 0, sizeof(Address));
-            *(int *)(&failedaddr.addr) = id;
-            *(short *)(&failedaddr.addr[4]) = port;
+    // nodes take turns with the full syncs so they do not all land on the same time unit
+    if ((this->localTime + *(int *)(&memberNode->addr.addr)) % FULL_SYNC_PERIOD == 0) {
+        // the whole list, in one shared buffer for all the chosen neighbours
+        vector<int> all = addressOrder();
+        sendEntries(sendaddrs, all, 0);
+        for (auto &addr : sendaddrs) {
+            gossipedUpTo[peerKey(*(int *)(&addr.addr), *(short *)(&addr.addr[4]))] = gossipSeq;
+        }
+    }
+    else {
+        // only what changed since this neighbour last heard from us. Its own entry only goes
+        // along while it is suspected, so that it learns of the suspicion and can refute it.
+        vector<int> order = addressOrder();
+        for (auto &addr : sendaddrs) {
+            int id = *(int *)(&addr.addr);
+            short port = *(short *)(&addr.addr[4]);
+            long &upTo = gossipedUpTo[peerKey(id, port)];
+            vector<int> changed;
+            for (int i : order) {
+                MemberListEntry &mle = memberNode->memberList[i];
+                if (mle.getid() == id && mle.getport() == port) {
+                    if (mle.state != MEMBER_ALIVE) {
+                        changed.push_back(i);
+                    }
+                }
+                else if (mle.updated > upTo) {
+                    changed.push_back(i);
+                }
+            }
+            vector<Address> to(1, addr);
+            sendEntries(to, changed, upTo);
+            upTo = gossipSeq;
         }
-        
     }
 
 
 
+    return;
+}
 
+/**
+ * FUNCTION NAME: touch
+ *
+ * DESCRIPTION: Mark an entry as changed, so the next delta to every neighbour carries it
+ */
+void MP1Node::touch(MemberListEntry *mle) {
+    mle->updated = ++gossipSeq;
+}
 
-    // send ping to random neighbours
+/**
+ * FUNCTION NAME: putVarint
+ *
+ * DESCRIPTION: Write v seven bits at a time, low bits first, the top bit set on all bytes but the last
+ *
+ * RETURNS:
+ * the byte after the varint
+ */
+static char *putVarint(char *p, unsigned long v) {
+    while (v >= 0x80) {
+        *p++ = (char) (v | 0x80);
+        v >>= 7;
+    }
+    *p++ = (char) v;
+    return p;
+}
 
-    std::shuffle(memberNode->memberList.begin() + 1, memberNode->memberList.end(), this->rng);
-    int n_ping = min(PING_NBR_CNT, this->n_members - 1);
+/**
+ * FUNCTION NAME: getVarint
+ *
+ * DESCRIPTION: Read a varint written by putVarint
+ *
+ * RETURNS:
+ * the byte after the varint, NULL if it runs past end
+ */
+static char *getVarint(char *p, char *end, unsigned long *v) {
+    *v = 0;
+    for (int shift = 0; p < end && shift < 64; shift += 7) {
+        unsigned char byte = *p++;
+        *v |= (unsigned long) (byte & 0x7f) << shift;
+        if (!(byte & 0x80)) {
+            return p;
+        }
+    }
+    return NULL;
+}
 
-    size_t msg_size = sizeof(MessageHdr) + sizeof(int) + this->n_members * sizeof(HeartBeatEntry);
-    MessageHdr *msg = (MessageHdr *) malloc(msg_size * sizeof(char));
-    msg->msgType = PINGHEARTBEAT;
-    int *n_entries = (int *) (msg + 1);
-    *n_entries = this->n_members;
-    HeartBeatEntry *entries = (HeartBeatEntry *) (n_entries + 1);
-    for (int i = 0; i < n_members; i++) {
-        MemberListEntry &mle = memberNode->memberList[i];
-        HeartBeatEntry entry;
-        init_entry(&entry, mle.getid(), mle.getport(), mle.getheartbeat());
-        memcpy(&entries[i], &entry, sizeof(HeartBeatEntry));
+// zigzag coding keeps small negative differences small: 0, -1, 1, -2 ... become 0, 1, 2, 3 ...
+static unsigned long zigzag(long v) {
+    return ((unsigned long) v << 1) ^ (unsigned long) (v >> 63);
+}
+
+static long unzigzag(unsigned long v) {
+    return (long) (v >> 1) ^ -(long) (v & 1);
+}
+
+/**
+ * FUNCTION NAME: sendEntries
+ *
+ * DESCRIPTION: Send the membership list entries at indexes to toaddrs as messages of type,
+ * 				in the order of indexes, which is address order for mergeEntries on the other end.
+ * 				Tombstones buried after change sequence number since go along as dead entries,
+ * 				slotted in by address. Entries are encoded as GossipHdr describes and split over
+ * 				as many messages as it takes to stay under MAX_MSG_SIZE.
+ */
+void MP1Node::sendEntries(vector<Address> &toaddrs, vector<int> &indexes, long since, enum MsgTypes type) {
+    size_t limit = par->MAX_MSG_SIZE - sizeof(en_msg) - 1;
+    vector<HeartBeatEntry> all;
+    map<long, Tombstone>::iterator grave = tombstones.begin();
+    HeartBeatEntry entry;
+    size_t done = 0;
+
+    if (toaddrs.empty()) {
+        return;
     }
-    
-    for (int i = 1; i <= n_ping; i++) {
-        if (memberNode->memberList[i].heartbeat == HeartBeat::FAILED) {
-            n_ping = min(n_ping + 1, this->n_members - 1);
-            continue;
+
+    all.reserve(indexes.size());
+    for (size_t i = 0; i <= indexes.size(); i++) {
+        long key = (i < indexes.size()) ? entryKey(memberNode->memberList[indexes[i]]) : LONG_MAX;
+        for (; grave != tombstones.end() && grave->first < key; grave++) {
+            if (grave->second.updated > since) {
+                init_entry(&entry, (int) (grave->first >> 16), (short) (grave->first & 0xffff), 0, MEMBER_DEAD, grave->second.incarnation);
+                all.push_back(entry);
+            }
         }
-        int id = memberNode->memberList[i].getid();
-        short port = memberNode->memberList[i].getport();
-        Address sendaddr;
-        memset(&sendaddr, 0, sizeof(Address));
-        *(int *)(&sendaddr.addr) = id;
-        *(short *)(&sendaddr.addr[4]) = port;
+        if (i < indexes.size()) {
+            MemberListEntry &mle = memberNode->memberList[indexes[i]];
+            init_entry(&entry, mle.getid(), mle.getport(), mle.getheartbeat(), mle.state, mle.incarnation);
+            all.push_back(entry);
+        }
+    }
 
-        emulNet->ENsend(&memberNode->addr, &sendaddr , (char *)msg, msg_size);
+    char *msg = (char *) malloc(limit);
+    while (done < all.size()) {
+        size_t used = sizeof(MessageHdr) + sizeof(GossipHdr);
+        int count = 0;
+        int prevId = 0;
+        long prevHb = 0;
+        char buf[GOSSIP_MAX_ENTRY];
+
+        while (done + count < all.size() && count < USHRT_MAX) {
+            HeartBeatEntry &e = all[done + count];
+            char *p = putVarint(buf, zigzag((long) getId(&e) - prevId));
+            p = putVarint(p, (unsigned short) getPort(&e));
+            p = putVarint(p, zigzag(e.heartbeat_no - prevHb));
+            p = putVarint(p, (unsigned long) e.incarnation);
+            // the entry and the two bitmaps with a bit more for it have to fit
+            if (used + (p - buf) + 2 * ((count + 8) / 8) > limit) {
+                break;
+            }
+            memcpy(msg + used, buf, p - buf);
+            used += p - buf;
+            prevId = getId(&e);
+            prevHb = e.heartbeat_no;
+            count++;
+        }
+
+        size_t bits = (count + 7) / 8;
+        char *dead = msg + used;
+        char *suspect = dead + bits;
+        memset(dead, 0, 2 * bits);
+        for (int i = 0; i < count; i++) {
+            if (all[done + i].state == MEMBER_DEAD) {
+                dead[i / 8] |= 1 << (i % 8);
+            }
+            else if (all[done + i].state == MEMBER_SUSPECT) {
+                suspect[i / 8] |= 1 << (i % 8);
+            }
+        }
+        used += 2 * bits;
+
+        ((MessageHdr *) msg)->msgType = type;
+        GossipHdr *gossip = (GossipHdr *) (msg + sizeof(MessageHdr));
+        gossip->version = GOSSIP_VERSION;
+        gossip->count = count;
+        emulNet->ENsendMulti(&memberNode->addr, toaddrs, msg, used, MP1_CHANNEL);
+        done += count;
+    }
+    free(msg);
+}
+
+/**
+ * FUNCTION NAME: decodeEntries
+ *
+ * DESCRIPTION: Decode the entries of a PINGHEARTBEAT or JOINREP of size bytes
+ *
+ * RETURNS:
+ * false if the message is of another GOSSIP_VERSION or cut short
+ */
+bool MP1Node::decodeEntries(MessageHdr *hdr, int size, vector<HeartBeatEntry> &entries) {
+    char *end = (char *) hdr + size;
+    GossipHdr *gossip = (GossipHdr *) (hdr + 1);
+    unsigned long id, port, hb, inc;
+    int prevId = 0;
+    long prevHb = 0;
+
+    if (size < (int) (sizeof(MessageHdr) + sizeof(GossipHdr)) || gossip->version != GOSSIP_VERSION) {
+        return false;
+    }
+    char *p = (char *) (gossip + 1);
+    entries.resize(gossip->count);
+    for (int i = 0; i < gossip->count; i++) {
+        if ((p = getVarint(p, end, &id)) == NULL || (p = getVarint(p, end, &port)) == NULL ||
+            (p = getVarint(p, end, &hb)) == NULL || (p = getVarint(p, end, &inc)) == NULL) {
+            return false;
+        }
+        prevId += (int) unzigzag(id);
+        prevHb += unzigzag(hb);
+        init_entry(&entries[i], prevId, (short) port, prevHb, MEMBER_ALIVE, (long) inc);
     }
 
+    size_t bits = (gossip->count + 7) / 8;
+    if ((size_t) (end - p) < 2 * bits) {
+        return false;
+    }
+    for (int i = 0; i < gossip->count; i++) {
+        if (p[i / 8] & (1 << (i % 8))) {
+            entries[i].state = MEMBER_DEAD;
+        }
+        else if (p[bits + i / 8] & (1 << (i % 8))) {
+            entries[i].state = MEMBER_SUSPECT;
+        }
+    }
+    return true;
+}
 
+/**
+ * FUNCTION NAME: findEntry
+ *
+ * DESCRIPTION: Membership list entry of a member, NULL if it is not in the list
+ */
+MemberListEntry *MP1Node::findEntry(long key) {
+    int id = (int) (key >> 16);
+    if (id < 0 || id >= (int) memberIndex.size() || memberIndex[id] < 0) {
+        return NULL;
+    }
+    MemberListEntry *mle = &memberNode->memberList[memberIndex[id]];
+    if (peerKey(mle->getid(), mle->getport()) != key) {
+        return NULL;
+    }
+    return mle;
+}
 
-    return;
+/**
+ * FUNCTION NAME: indexEntry
+ *
+ * DESCRIPTION: Record where the member at pos of memberList is. Emulnet ids are handed out
+ * 				densely from 1, so the index is a plain array.
+ */
+void MP1Node::indexEntry(int pos) {
+    int id = memberNode->memberList[pos].getid();
+    if (id < 0) {
+        return;
+    }
+    if (id >= (int) memberIndex.size()) {
+        memberIndex.resize(max(id + 1, (int) memberIndex.size() * 2), -1);
+    }
+    memberIndex[id] = pos;
+}
+
+/**
+ * FUNCTION NAME: reindex
+ *
+ * DESCRIPTION: Rebuild the index after memberList was reordered or had entries taken out
+ */
+void MP1Node::reindex() {
+    fill(memberIndex.begin(), memberIndex.end(), -1);
+    for (int i = 0; i < (int) memberNode->memberList.size(); i++) {
+        indexEntry(i);
+    }
+    peerPoolStale = true;
+}
+
+/**
+ * FUNCTION NAME: pickPeers
+ *
+ * DESCRIPTION: Up to k random members other than us that are not dead, skipping exclude.
+ * 				A partial Fisher-Yates pass over peerPool: the first k slots get random picks
+ * 				from the rest, so a pick costs O(k) plus the dead members it runs into.
+ * 				The pool is a permutation before and after, so it is reused from tick to tick
+ * 				and only rebuilt when positions in memberList change.
+ *
+ * RETURNS:
+ * positions in memberList
+ */
+vector<int> MP1Node::pickPeers(int k, long exclude) {
+    vector<int> picked;
+
+    if (peerPoolStale || peerPool.size() + 1 != memberNode->memberList.size()) {
+        peerPool.resize(max((int) memberNode->memberList.size() - 1, 0));
+        for (int i = 0; i < (int) peerPool.size(); i++) {
+            peerPool[i] = i + 1;
+        }
+        peerPoolStale = false;
+    }
+
+    for (int j = 0; j < (int) peerPool.size() && (int) picked.size() < k; j++) {
+        uniform_int_distribution<int> pick(j, peerPool.size() - 1);
+        swap(peerPool[j], peerPool[pick(this->rng)]);
+        MemberListEntry &mle = memberNode->memberList[peerPool[j]];
+        if (mle.state != MEMBER_DEAD && entryKey(mle) != exclude) {
+            picked.push_back(peerPool[j]);
+        }
+    }
+    return picked;
+}
+
+/**
+ * FUNCTION NAME: addressOrder
+ *
+ * DESCRIPTION: Positions of memberList in address order. Our own entry stays at the front of
+ * 				memberList and the rest is kept sorted, so only ours has to be slotted in.
+ */
+vector<int> MP1Node::addressOrder() {
+    vector<MemberListEntry> &list = memberNode->memberList;
+    vector<int> order;
+    order.reserve(list.size());
+
+    int rank = lower_bound(list.begin() + 1, list.end(), list[0], keyLess) - list.begin();
+    for (int i = 1; i < rank; i++) {
+        order.push_back(i);
+    }
+    order.push_back(0);
+    for (int i = rank; i < (int) list.size(); i++) {
+        order.push_back(i);
+    }
+    return order;
+}
+
+/**
+ * FUNCTION NAME: insertEntry
+ *
+ * DESCRIPTION: Insert a member at its place in address order
+ *
+ * RETURNS:
+ * the entry in memberList
+ */
+MemberListEntry *MP1Node::insertEntry(MemberListEntry &mle) {
+    vector<MemberListEntry> &list = memberNode->memberList;
+    int pos = lower_bound(list.begin() + 1, list.end(), mle, keyLess) - list.begin();
+
+    list.insert(list.begin() + pos, mle);
+    for (int i = pos; i < (int) list.size(); i++) {
+        indexEntry(i);
+    }
+    peerPoolStale = true;
+    return &list[pos];
+}
+
+/**
+ * FUNCTION NAME: swimLoopOps
+ *
+ * DESCRIPTION: One time unit of the SWIM detector. Every SWIM_PERIOD a member pings the next
+ * 				member of a randomly ordered round. Without an ack after SWIM_PING_TIMEOUT it asks
+ * 				SWIM_INDIRECT_CNT others to ping the target for it; without any ack by the end of
+ * 				the period the target becomes a suspect. Suspects that do not refute within
+ * 				SWIM_SUSPECT_TIMEOUT are declared dead by nodeLoopOps. State changes travel
+ * 				piggybacked on the probes, so the load of a member does not grow with the group.
+ */
+void MP1Node::swimLoopOps() {
+    if (probeTarget >= 0 && !probeAcked) {
+        if (this->localTime - probeStart >= SWIM_PERIOD) {
+            // neither the target nor anyone on our behalf got an ack back this period
+            suspect(probeTarget);
+        }
+        else if (!probeIndirect && this->localTime - probeStart >= SWIM_PING_TIMEOUT) {
+            for (int i : pickPeers(SWIM_INDIRECT_CNT, probeTarget)) {
+                MemberListEntry &mle = memberNode->memberList[i];
+                Address helper = keyAddress(peerKey(mle.getid(), mle.getport()));
+                Address target = keyAddress(probeTarget);
+                SwimProbe probe;
+                memcpy(probe.target, target.addr, sizeof(probe.target));
+                memcpy(probe.origin, memberNode->addr.addr, sizeof(probe.origin));
+                probe.seq = probeSeq;
+                swimSend(&helper, PINGREQ, &probe);
+            }
+            probeIndirect = true;
+        }
+    }
+
+    if (probeTarget < 0 || this->localTime - probeStart >= SWIM_PERIOD) {
+        probeTarget = swimNextTarget();
+        probeStart = this->localTime;
+        probeAcked = false;
+        probeIndirect = false;
+        if (probeTarget >= 0) {
+            Address target = keyAddress(probeTarget);
+            SwimProbe probe;
+            memcpy(probe.target, target.addr, sizeof(probe.target));
+            memcpy(probe.origin, memberNode->addr.addr, sizeof(probe.origin));
+            probe.seq = ++probeSeq;
+            swimSend(&target, PING, &probe);
+        }
+    }
+}
+
+/**
+ * FUNCTION NAME: swimNextTarget
+ *
+ * DESCRIPTION: Next member to probe. Members are probed round-robin in an order that is
+ * 				shuffled anew every round, which bounds the time until a failed member is probed.
+ *
+ * RETURNS:
+ * peerKey of the member, -1 if there is no one to probe
+ */
+long MP1Node::swimNextTarget() {
+    for (int round = 0; round < 2; round++) {
+        while (probeNext < probeOrder.size()) {
+            long key = probeOrder[probeNext++];
+            MemberListEntry *mle = findEntry(key);
+            if (mle != NULL && mle->state != MEMBER_DEAD) {
+                return key;
+            }
+        }
+        probeOrder.clear();
+        for (size_t i = 1; i < memberNode->memberList.size(); i++) {
+            MemberListEntry &mle = memberNode->memberList[i];
+            if (mle.state != MEMBER_DEAD) {
+                probeOrder.push_back(peerKey(mle.getid(), mle.getport()));
+            }
+        }
+        std::shuffle(probeOrder.begin(), probeOrder.end(), this->rng);
+        probeNext = 0;
+    }
+    return -1;
+}
+
+/**
+ * FUNCTION NAME: suspect
+ *
+ * DESCRIPTION: Start suspecting a member that is alive as far as we know, and tell the others
+ */
+void MP1Node::suspect(long key) {
+    MemberListEntry *mle = findEntry(key);
+    if (mle == NULL || mle->state != MEMBER_ALIVE) {
+        return;
+    }
+    setState(mle, MEMBER_SUSPECT);
+    touch(mle);
+    suspectedAt[key] = this->localTime;
+    if (par->DETECTOR == SWIM_DETECTOR) {
+        swimEnqueue(key, MEMBER_SUSPECT, mle->incarnation);
+    }
+}
+
+/**
+ * FUNCTION NAME: swimRecv
+ *
+ * DESCRIPTION: Handle a PING, ACK or PINGREQ: apply the piggybacked updates, then answer the
+ * 				ping, probe on behalf of the origin, or take in or pass on the ack
+ */
+void MP1Node::swimRecv(MessageHdr *hdr, int size) {
+    SwimProbe *probe = (SwimProbe *) (hdr + 1);
+    int *n_updates = (int *) (probe + 1);
+    SwimUpdate *updates = (SwimUpdate *) (n_updates + 1);
+
+    if (size < (int) (sizeof(MessageHdr) + sizeof(SwimProbe) + sizeof(int)) ||
+        size < (int) (sizeof(MessageHdr) + sizeof(SwimProbe) + sizeof(int) + *n_updates * sizeof(SwimUpdate))) {
+        return;
+    }
+    for (int i = 0; i < *n_updates; i++) {
+        swimApply(&updates[i]);
+    }
+
+    Address from = keyAddress(addressKey(probe->from));
+    switch (hdr->msgType) {
+        case PING:
+            swimSend(&from, ACK, probe);
+            break;
+        case PINGREQ: {
+            Address target = keyAddress(addressKey(probe->target));
+            swimSend(&target, PING, probe);
+            break;
+        }
+        case ACK:
+            if (addressKey(probe->origin) == addressKey(memberNode->addr.addr)) {
+                if (probe->seq == probeSeq && addressKey(probe->target) == probeTarget) {
+                    probeAcked = true;
+                }
+            }
+            else {
+                // we probed on behalf of the origin
+                Address origin = keyAddress(addressKey(probe->origin));
+                swimSend(&origin, ACK, probe);
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+/**
+ * FUNCTION NAME: swimSend
+ *
+ * DESCRIPTION: Send a SWIM message with as many pending updates piggybacked as fit,
+ * 				those sent the fewest times first
+ */
+void MP1Node::swimSend(Address *to, enum MsgTypes type, SwimProbe *probe) {
+    sort(swimUpdates.begin(), swimUpdates.end(),
+         [](const pair<SwimUpdate, int> &a, const pair<SwimUpdate, int> &b) { return a.second > b.second; });
+    // updates that went out often enough have reached the group with high probability
+    while (!swimUpdates.empty() && swimUpdates.back().second <= 0) {
+        swimUpdates.pop_back();
+    }
+    int n_updates = min(SWIM_PIGGYBACK, (int) swimUpdates.size());
+
+    size_t msg_size = sizeof(MessageHdr) + sizeof(SwimProbe) + sizeof(int) + n_updates * sizeof(SwimUpdate);
+    MessageHdr *msg = (MessageHdr *) malloc(msg_size * sizeof(char));
+    msg->msgType = type;
+    SwimProbe *body = (SwimProbe *) (msg + 1);
+    memcpy(body, probe, sizeof(SwimProbe));
+    memcpy(body->from, memberNode->addr.addr, sizeof(body->from));
+    int *count = (int *) (body + 1);
+    *count = n_updates;
+    SwimUpdate *updates = (SwimUpdate *) (count + 1);
+    for (int i = 0; i < n_updates; i++) {
+        memcpy(&updates[i], &swimUpdates[i].first, sizeof(SwimUpdate));
+        swimUpdates[i].second--;
+    }
+
+    emulNet->ENsend(&memberNode->addr, to, (char *)msg, msg_size, MP1_CHANNEL);
+    free(msg);
+}
+
+/**
+ * FUNCTION NAME: swimEnqueue
+ *
+ * DESCRIPTION: Queue an update for dissemination, replacing an older one about the same member
+ */
+void MP1Node::swimEnqueue(long key, int state, long incarnation) {
+    SwimUpdate upd;
+    Address addr = keyAddress(key);
+    memcpy(upd.addr, addr.addr, sizeof(upd.addr));
+    upd.state = state;
+    upd.incarnation = incarnation;
+
+    int retransmits = SWIM_RETRANSMIT_MULT * (int) ceil(log2(memberNode->memberList.size() + 1));
+    for (auto &pending : swimUpdates) {
+        if (addressKey(pending.first.addr) == key) {
+            pending = make_pair(upd, retransmits);
+            return;
+        }
+    }
+    swimUpdates.push_back(make_pair(upd, retransmits));
+}
+
+/**
+ * FUNCTION NAME: swimApply
+ *
+ * DESCRIPTION: Merge a piggybacked update into the membership list, see mergeEntry,
+ * 				and pass it on if it told us something new
+ */
+void MP1Node::swimApply(SwimUpdate *upd) {
+    long key = addressKey(upd->addr);
+    MemberListEntry *mle = findEntry(key);
+    HeartBeatEntry entry;
+
+    // SWIM does not gossip heartbeats, so keep the one we have
+    init_entry(&entry, *(int *)upd->addr, *(short *)(&upd->addr[4]), (mle != NULL) ? mle->getheartbeat() : 0, upd->state, upd->incarnation);
+    if (updateEntry(&entry)) {
+        mle = findEntry(key);
+        swimEnqueue(key, mle->state, mle->incarnation);
+    }
 }
 
 /**
@@ -403,13 +1005,28 @@ int MP1Node::isNullAddress(Address *addr) {
 /**
  * FUNCTION NAME: getJoinAddress
  *
- * DESCRIPTION: Returns the Address of the coordinator
+ * DESCRIPTION: Returns the Address of the introducer to send the next JOINREQ to, our own
+ * 				if we are the first of SEEDS and boot the group. Joiners start at different
+ * 				introducers, which spreads a mass join over all of them, and move on to the next
+ * 				one on every retry.
  */
 Address MP1Node::getJoinAddress() {
     Address joinaddr;
+    vector<int> &seeds = par->SEEDS;
+    int self = *(int *)(&memberNode->addr.addr);
+    int id = seeds[0];
+
+    if (self != seeds[0]) {
+        for (size_t i = 0; i < seeds.size(); i++) {
+            id = seeds[(self + joinAttempts + i) % seeds.size()];
+            if (id != self) {
+                break;
+            }
+        }
+    }
 
     memset(&joinaddr, 0, sizeof(Address));
-    *(int *)(&joinaddr.addr) = 1;
+    *(int *)(&joinaddr.addr) = id;
     *(short *)(&joinaddr.addr[4]) = 0;
 
     return joinaddr;
@@ -421,61 +1038,274 @@ Address MP1Node::getJoinAddress() {
  * DESCRIPTION: Initialize the membership list
  */
 
-void MP1Node::updateEntry(HeartBeatEntry *hb_entry) {
+bool MP1Node::updateEntry(HeartBeatEntry *hb_entry) {
     int id = getId(hb_entry);
     short port = getPort(hb_entry);
     long hb = get_heartbeat_no(hb_entry);
-    bool found = false;
-    for (int i = 0; i < this->n_members; i++) {
-        MemberListEntry *table_entry = &memberNode->memberList[i];
-        if (table_entry->getid() == id && table_entry->getport() == port) {
-            found = true;
-            if (table_entry->heartbeat != HeartBeat::FAILED  && hb == HeartBeat::FAILED) {
-
-                table_entry->setheartbeat(HeartBeat::FAILED);
-                table_entry->settimestamp(localTime);
-            }
-            else if (table_entry->heartbeat != HeartBeat::FAILED &&  table_entry->getheartbeat() < hb) {
-                table_entry->setheartbeat(hb);
-                table_entry->settimestamp(localTime);
-            }       
-        }
+    MemberListEntry *table_entry = findEntry(peerKey(id, port));
+    if (table_entry != NULL) {
+        return mergeEntry(table_entry, hb, hb_entry->state, hb_entry->incarnation);
     }
-    if (!found && hb != HeartBeat::FAILED) {
-
-        
-
+    else if (admit(peerKey(id, port), hb_entry->state, hb_entry->incarnation)) {
         MemberListEntry mle(id, port, hb, localTime);
+        mle.state = hb_entry->state;
+        mle.incarnation = hb_entry->incarnation;
 
-
-    
-        Address failedaddr;
-        memset(&failedaddr, 0, sizeof(Address));
-        *(int *)(&failedaddr.addr) = id;
-        *(short *)(&failedaddr.addr[4]) = port;
-        char str[512];
-
-        memberNode->memberList.push_back(mle);
+        touch(insertEntry(mle));
+        publish(JOIN_EVENT, peerKey(id, port));
+        if (mle.state == MEMBER_SUSPECT) {
+            suspectedAt[peerKey(id, port)] = localTime;
+        }
 
         Address newaddr;
         memset(&newaddr, 0, sizeof(Address));
         *(int *)(&newaddr.addr) = id;
         *(short *)(&newaddr.addr[4]) = port;
         log->logNodeAdd(&memberNode->addr, &newaddr);
-        this->n_members++;
+        return true;
+    }
+    return false;
+}
+
+/**
+ * FUNCTION NAME: admit
+ *
+ * DESCRIPTION: Decide on news about a member that is not in memberList. News of its death is
+ * 				buried, unless we hold a tombstone at least as recent. Anything else is let in only
+ * 				if it is more recent than the tombstone, if any, which is then lifted: stale gossip
+ * 				about a member that died cannot bring it back.
+ *
+ * RETURNS:
+ * true if the member is to be added
+ */
+bool MP1Node::admit(long key, int state, long incarnation) {
+    if (tombstones.covers(key, incarnation)) {
+        return false;
+    }
+    if (state == MEMBER_DEAD) {
+        tombstones.bury(key, incarnation, ++gossipSeq, this->localTime);
+        return false;
+    }
+    tombstones.lift(key);
+    return true;
+}
+
+/**
+ * FUNCTION NAME: bury
+ *
+ * DESCRIPTION: Move a dead member out of memberList into the tombstones. The caller takes the
+ * 				entry out of the list.
+ */
+void MP1Node::bury(MemberListEntry *mle) {
+    long key = entryKey(*mle);
+    Address deadaddr = keyAddress(key);
+
+    tombstones.bury(key, mle->incarnation, ++gossipSeq, this->localTime);
+    log->logNodeRemove(&memberNode->addr, &deadaddr);
+    publish(REMOVE_EVENT, key);
+    gossipedUpTo.erase(key);
+    suspectedAt.erase(key);
+}
+
+/**
+ * FUNCTION NAME: mergeEntry
+ *
+ * DESCRIPTION: Take in what a peer knows about a member we know. The state it reports wins if its
+ * 				incarnation is higher than ours, or the same and the state is a later one.
+ * 				Heartbeats count on their own, as long as neither side has the member dead.
+ * 				News that we ourselves are suspected or dead is refuted with an incarnation above it,
+ * 				which wins over the suspicion wherever our entry goes next.
+ *
+ * RETURNS:
+ * true if the state or incarnation of the entry changed
+ */
+bool MP1Node::mergeEntry(MemberListEntry *table_entry, long hb, int state, long incarnation) {
+    long key = entryKey(*table_entry);
+    bool changed = false;
+
+    if (table_entry == &memberNode->memberList[0]) {
+        if (state != MEMBER_ALIVE && incarnation >= table_entry->incarnation) {
+            table_entry->incarnation = incarnation + 1;
+            touch(table_entry);
+            return true;
+        }
+        return false;
     }
+
+    if (incarnation > table_entry->incarnation || (incarnation == table_entry->incarnation && state > table_entry->state)) {
+        if (state == MEMBER_SUSPECT) {
+            suspectedAt[key] = localTime;
+        }
+        else {
+            suspectedAt.erase(key);
+        }
+        if (table_entry->state == MEMBER_DEAD) {
+            // a fresh start for a member back from the dead before it was buried
+            table_entry->settimestamp(localTime);
+        }
+        setState(table_entry, state);
+        table_entry->incarnation = incarnation;
+        touch(table_entry);
+        changed = true;
+    }
+
+    if (table_entry->state != MEMBER_DEAD && state != MEMBER_DEAD && table_entry->getheartbeat() < hb) {
+        // one more heartbeat interval for the phi accrual detector
+        double interval = localTime - table_entry->gettimestamp();
+        if (table_entry->arrivals == 0) {
+            table_entry->arrivalMean = interval;
+            table_entry->arrivalVar = 0;
+        }
+        else {
+            double diff = interval - table_entry->arrivalMean;
+            table_entry->arrivalMean += PHI_ALPHA * diff;
+            table_entry->arrivalVar = (1 - PHI_ALPHA) * (table_entry->arrivalVar + PHI_ALPHA * diff * diff);
+        }
+        table_entry->arrivals++;
+        table_entry->setheartbeat(hb);
+        table_entry->settimestamp(localTime);
+        touch(table_entry);
+    }
+    return changed;
 }
 
+/**
+ * FUNCTION NAME: mergeEntries
+ *
+ * DESCRIPTION: Merge a list of heartbeats sent in address order into memberList in one pass,
+ * 				walking both side by side. New members are collected and merged in at the end.
+ * 				A list out of order falls back to updateEntry for every entry.
+ */
+void MP1Node::mergeEntries(HeartBeatEntry *entries, int count) {
+    vector<MemberListEntry> &list = memberNode->memberList;
+    vector<MemberListEntry> added;
+    long selfKey = entryKey(list[0]);
+    size_t pos = 1;
+
+    for (int i = 1; i < count; i++) {
+        if (peerKey(getId(&entries[i - 1]), getPort(&entries[i - 1])) >= peerKey(getId(&entries[i]), getPort(&entries[i]))) {
+            for (int j = 0; j < count; j++) {
+                updateEntry(&entries[j]);
+            }
+            return;
+        }
+    }
+
+    for (int i = 0; i < count; i++) {
+        int id = getId(&entries[i]);
+        short port = getPort(&entries[i]);
+        long key = peerKey(id, port);
+        long hb = get_heartbeat_no(&entries[i]);
+        int state = entries[i].state;
+        long incarnation = entries[i].incarnation;
+
+        if (key == selfKey) {
+            mergeEntry(&list[0], hb, state, incarnation);
+            continue;
+        }
+        while (pos < list.size() && entryKey(list[pos]) < key) {
+            pos++;
+        }
+        if (pos < list.size() && entryKey(list[pos]) == key) {
+            mergeEntry(&list[pos], hb, state, incarnation);
+        }
+        else if (admit(key, state, incarnation)) {
+            added.push_back(MemberListEntry(id, port, hb, localTime));
+            added.back().state = state;
+            added.back().incarnation = incarnation;
+        }
+    }
+
+    if (added.empty()) {
+        return;
+    }
+    // added is in address order too, so one merge puts everything in place
+    size_t old = list.size();
+    list.insert(list.end(), added.begin(), added.end());
+    for (size_t i = old; i < list.size(); i++) {
+        touch(&list[i]);
+        if (list[i].state == MEMBER_SUSPECT) {
+            suspectedAt[entryKey(list[i])] = localTime;
+        }
+        Address newaddr = keyAddress(entryKey(list[i]));
+        log->logNodeAdd(&memberNode->addr, &newaddr);
+        publish(JOIN_EVENT, entryKey(list[i]));
+    }
+    inplace_merge(list.begin() + 1, list.begin() + old, list.end(), keyLess);
+    reindex();
+}
 
 void MP1Node::initMemberListTable(Member *memberNode) {
 	memberNode->memberList.clear();
+    memberIndex.clear();
+    peerPoolStale = true;
     int id = *(int*)(&memberNode->addr.addr); // ip address 32 bit
 	short port = *(short*)(&memberNode->addr.addr[4]); // 16 bit port
     MemberListEntry entry(id, port, memberNode->heartbeat, localTime);
     memberNode->memberList.push_back(entry);
+    indexEntry(0);
+    touch(&memberNode->memberList.back());
+    publish(JOIN_EVENT, entryKey(entry));
     memberNode->myPos = memberNode->memberList.begin();
 }
 
+/**
+ * FUNCTION NAME: publish
+ *
+ * DESCRIPTION: Tell MP2 about a change of the membership list. Every event moves the epoch,
+ * 				so an epoch that stayed put means there is nothing to look at.
+ */
+void MP1Node::publish(int type, long key) {
+    memberNode->epoch++;
+    memberNode->events.push(MemberEvent(memberNode->epoch, type, keyAddress(key)));
+}
+
+/**
+ * FUNCTION NAME: setState
+ *
+ * DESCRIPTION: Move a member to another state and publish the change. Dead members are out of
+ * 				the ring, so leaving or entering the dead state is what MP2 has to act on.
+ */
+void MP1Node::setState(MemberListEntry *mle, int state) {
+    int old = mle->state;
+
+    if (old == state) {
+        return;
+    }
+    mle->state = state;
+    if (state == MEMBER_DEAD) {
+        publish(DEAD_EVENT, entryKey(*mle));
+    }
+    else if (old == MEMBER_DEAD) {
+        publish(JOIN_EVENT, entryKey(*mle));
+    }
+    else {
+        publish(state == MEMBER_SUSPECT ? SUSPECT_EVENT : ALIVE_EVENT, entryKey(*mle));
+    }
+}
+
+/**
+ * FUNCTION NAME: phi
+ *
+ * DESCRIPTION: Suspicion level of a member, after Hayashibara et al.: -log10 of the probability
+ * 				that its next heartbeat still comes, given how long it has been quiet and a normal
+ * 				distribution fitted to its past heartbeat intervals. A phi of 8 means we would be
+ * 				wrong to declare it failed about once in 10^8 times. The normal tail uses the
+ * 				logistic approximation, which needs no erf.
+ */
+double MP1Node::phi(MemberListEntry *mle) {
+    double mean = (mle->arrivals > 0) ? mle->arrivalMean : PHI_FIRST_INTERVAL;
+    double stddev = max(sqrt(mle->arrivalVar), PHI_MIN_STDDEV);
+    double quiet = this->localTime - mle->gettimestamp();
+    double y = (quiet - mean) / stddev;
+    double e = exp(-y * (1.5976 + 0.070566 * y * y));
+
+    if (quiet > mean) {
+        return -log10(e / (1.0 + e));
+    }
+    return -log10(1.0 - 1.0 / (1.0 + e));
+}
+
 /**
  * FUNCTION NAME: printAddress
  *
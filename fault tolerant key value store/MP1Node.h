@@ -14,16 +14,52 @@
 #include "Member.h"
 #include "EmulNet.h"
 #include "Queue.h"
+#include "Tombstones.h"
 #include <random>
 #include <chrono>
 #include <functional>
+#include <climits>
 /**
  * Macros
  */
+// dead members are remembered for TOMBSTONE_BUCKETS buckets of TREMOVE time units
 #define TREMOVE 15
+#define TOMBSTONE_BUCKETS 3
+// fixed failure timeout, used when PHI_THRESHOLD is 0
 #define TFAIL 10
+// time units a suspect has to refute the suspicion before it is declared dead
+#define TSUSPECT 5
+// weight of a new heartbeat interval in the running mean and variance of the phi accrual detector
+#define PHI_ALPHA 0.125
+// heartbeat interval assumed for a member before the first one is measured, in time units
+#define PHI_FIRST_INTERVAL 2
+// floor of the standard deviation; intervals are whole time units, so it cannot be much smaller
+#define PHI_MIN_STDDEV 1.0
+// least time units to wait for a JOINREP before asking the next introducer
+#define JOIN_TIMEOUT 5
 #define PING_NBR_CNT 4
 #define GOSSIP_NBR_CNT 5
+// a neighbour gets the whole membership list every FULL_SYNC_PERIOD time units, only the changes otherwise
+#define FULL_SYNC_PERIOD 10
+// encoding of the entries in PINGHEARTBEAT and JOINREP, see GossipHdr
+#define GOSSIP_VERSION 1
+// most bytes one encoded entry takes: four varints
+#define GOSSIP_MAX_ENTRY 40
+/*
+ * SWIM detector, selected with FAILURE_DETECTOR: SWIM
+ */
+// time units of a protocol period, every member probes one other per period
+#define SWIM_PERIOD 6
+// time units to wait for the direct ack before asking others to probe
+#define SWIM_PING_TIMEOUT 2
+// members asked to probe on our behalf
+#define SWIM_INDIRECT_CNT 3
+// TSUSPECT of the SWIM detector, whose suspicions take a protocol period or two to reach the suspect
+#define SWIM_SUSPECT_TIMEOUT 12
+// an update is piggybacked SWIM_RETRANSMIT_MULT * log2(members) times
+#define SWIM_RETRANSMIT_MULT 3
+// updates piggybacked on one probe message
+#define SWIM_PIGGYBACK 6
 /*
  * Note: You can change/add any functions in MP1Node.{h,cpp}
  */
@@ -32,14 +68,13 @@
  * Message Types
  */
 
-enum HeartBeat{
-	FAILED = -1
-};
-
 enum MsgTypes{
     JOINREQ,
     JOINREP,
-	PINGHEARTBEAT
+	PINGHEARTBEAT,
+	PING,
+	ACK,
+	PINGREQ
 };
 
 /**
@@ -52,11 +87,59 @@ typedef struct MessageHdr {
 }MessageHdr;
 
 
+/**
+ * STRUCT NAME: HeartBeatEntry
+ *
+ * DESCRIPTION: A member as gossiped: its heartbeat, its MemberState and the incarnation of that state
+ */
 typedef struct HeartBeatEntry {
 	char addr[6];
+	char state;
+	long incarnation;
 	long heartbeat_no;
 }HeartBeatEntry;
 
+/**
+ * STRUCT NAME: GossipHdr
+ *
+ * DESCRIPTION: Start of the body of PINGHEARTBEAT and JOINREP, which carry HeartBeatEntry
+ * 				in address order, encoded. count entries follow, each as four varints: the id less
+ * 				the id of the entry before it, the port, the heartbeat less the heartbeat of the
+ * 				entry before it, and the incarnation. Differences are zigzag coded. Ids are dense and
+ * 				the heartbeats of members that joined about the same time are close, so most entries
+ * 				take four or five bytes. Then a bitmap of the dead entries and one of the suspects,
+ * 				a bit per entry.
+ */
+typedef struct GossipHdr {
+	unsigned char version;
+	unsigned short count;
+}GossipHdr;
+
+/**
+ * STRUCT NAME: SwimProbe
+ *
+ * DESCRIPTION: Body of the SWIM PING, ACK and PINGREQ messages. origin is the member that
+ * 				wants the ack; it differs from from when the probe is made on its behalf.
+ * 				Followed by an int count and that many SwimUpdate.
+ */
+typedef struct SwimProbe {
+	char from[6];
+	char target[6];
+	char origin[6];
+	int seq;
+}SwimProbe;
+
+/**
+ * STRUCT NAME: SwimUpdate
+ *
+ * DESCRIPTION: Membership update piggybacked on SWIM messages
+ */
+typedef struct SwimUpdate {
+	char addr[6];
+	char state;
+	long incarnation;
+}SwimUpdate;
+
 
 
 
@@ -77,8 +160,77 @@ private:
 	Params *par;
 	Member *memberNode;
 	long localTime;
-	int n_members; // Number of members in the group known to this node.
 	char NULLADDR[6];
+	// JOINREQs sent so far and the time of the last one, see getJoinAddress
+	int joinAttempts;
+	long joinSentAt;
+	// time units to wait for a JOINREP, longer than a round trip over the slowest link
+	long joinTimeout;
+	// bumped on every change to the membership list, see touch
+	long gossipSeq;
+	// gossipSeq as of the last heartbeat message sent to a neighbour, by peerKey
+	map<long, long> gossipedUpTo;
+	// position of every member in memberList, indexed by emulnet id, -1 for none
+	vector<int> memberIndex;
+	// members declared dead, out of memberList
+	TombstoneStore tombstones;
+	void bury(MemberListEntry *mle);
+	bool admit(long key, int state, long incarnation);
+	void indexEntry(int pos);
+	void reindex();
+	static long entryKey(const MemberListEntry &mle) {
+		return peerKey(mle.id, mle.port);
+	}
+	static bool keyLess(const MemberListEntry &a, const MemberListEntry &b) {
+		return entryKey(a) < entryKey(b);
+	}
+	vector<int> addressOrder();
+	// positions 1.. of memberList in the order pickPeers left them, rebuilt when membership changes
+	vector<int> peerPool;
+	bool peerPoolStale;
+	vector<int> pickPeers(int k, long exclude);
+	MemberListEntry *insertEntry(MemberListEntry &mle);
+	bool mergeEntry(MemberListEntry *table_entry, long hb, int state, long incarnation);
+	void mergeEntries(HeartBeatEntry *entries, int count);
+	bool decodeEntries(MessageHdr *hdr, int size, vector<HeartBeatEntry> &entries);
+	void touch(MemberListEntry *mle);
+	void publish(int type, long key);
+	void setState(MemberListEntry *mle, int state);
+	void sendEntries(vector<Address> &toaddrs, vector<int> &indexes, long since, enum MsgTypes type = PINGHEARTBEAT);
+	static long peerKey(int id, short port) {
+		return ((long) id << 16) | (unsigned short) port;
+	}
+	static Address keyAddress(long key) {
+		Address addr;
+		addr.init();
+		*(int *)(&addr.addr) = (int) (key >> 16);
+		*(short *)(&addr.addr[4]) = (short) (key & 0xffff);
+		return addr;
+	}
+	static long addressKey(char *addr) {
+		return peerKey(*(int *)addr, *(short *)(&addr[4]));
+	}
+	// SWIM: members left to probe this round, in random order
+	vector<long> probeOrder;
+	size_t probeNext;
+	// SWIM: the probe of the current protocol period
+	long probeTarget;
+	int probeSeq;
+	long probeStart;
+	bool probeAcked;
+	bool probeIndirect;
+	// time each suspect was suspected at, by peerKey
+	map<long, long> suspectedAt;
+	// SWIM: updates to piggyback and how many more times each goes out
+	vector< pair<SwimUpdate, int> > swimUpdates;
+	void swimLoopOps();
+	long swimNextTarget();
+	void suspect(long key);
+	void swimRecv(MessageHdr *hdr, int size);
+	void swimSend(Address *to, enum MsgTypes type, SwimProbe *probe);
+	void swimEnqueue(long key, int state, long incarnation);
+	void swimApply(SwimUpdate *upd);
+	MemberListEntry *findEntry(long key);
 
 
 public:
@@ -88,6 +240,8 @@ public:
 	}
 	int recvLoop();
 	static int enqueueWrapper(void *env, char *buff, int size);
+	static int msgTypeOf(char *data, int size);
+	static vector<string> msgTypeNames();
 	void nodeStart(char *servaddrstr, short serverport);
 	int initThisNode(Address *joinaddr);
 	int introduceSelfToGroup(Address *joinAddress);
@@ -99,8 +253,9 @@ public:
 	int isNullAddress(Address *addr);
 	Address getJoinAddress();
 	void initMemberListTable(Member *memberNode);
+	double phi(MemberListEntry *mle);
 	void printAddress(Address *addr);
-	void updateEntry(HeartBeatEntry *hb_entry);
+	bool updateEntry(HeartBeatEntry *hb_entry);
 	virtual ~MP1Node();
 	default_random_engine rng;
 	int getId(HeartBeatEntry* entry) {
@@ -117,9 +272,11 @@ public:
 		return entry->heartbeat_no;
 	}
 
-	void init_entry(HeartBeatEntry* entry, int id, short port, int beat_no) {
+	void init_entry(HeartBeatEntry* entry, int id, short port, long beat_no, int state = MEMBER_ALIVE, long incarnation = 0) {
 		memcpy(entry->addr, &id, sizeof(int));
 		memcpy(&(entry->addr[4]), &port, sizeof(short));
+		entry->state = state;
+		entry->incarnation = incarnation;
 		entry->heartbeat_no = beat_no;
 	}
 
@@ -19,6 +19,7 @@ MP2Node::MP2Node(Member *memberNode, Params *par, EmulNet * emulNet, Log * log,
 	this->log = log;
 	ht = new HashTable();
 	this->memberNode->addr = *address;
+	this->ringEpoch = 0;
 }
 
 /**
@@ -33,82 +34,82 @@ MP2Node::~MP2Node() {
  * FUNCTION NAME: updateRing
  *
  * DESCRIPTION: This function does the following:
- * 				1) Gets the current membership list from the Membership Protocol (MP1Node)
- * 				   The membership list is returned as a vector of Nodes. See Node class in Node.h
- * 				2) Constructs the ring based on the membership list
+ * 				1) Gets the membership changes published by the Membership Protocol (MP1Node)
+ * 				   since the last call. Nothing is done while the membership epoch stays the same.
+ * 				2) Applies them to the ring, which stays sorted by hashCode
  * 				3) Calls the Stabilization Protocol
  */
 void MP2Node::updateRing() {
-	/*
-	 * Implement this. Parts of it are already implemented
-	 */
-	vector<Node> curMemList;
 	bool changed = false;
 
 	/*
-	 *  Step 1. Get the current membership list from Membership Protocol / MP1
+	 *  Step 1. Get the membership changes from Membership Protocol / MP1
 	 */
-	
-	curMemList = getMembershipList();
+	if ( memberNode->epoch == ringEpoch ) {
+		return;
+	}
 
 	/*
-	 * Step 2: Construct the ring
+	 * Step 2: Apply them to the ring
 	 */
-	// Sort the list based on the hashCode
-	
-	sort(curMemList.begin(), curMemList.end());
-
-	if(ring.size() != curMemList.size()){
-		changed = true;
-	}
-
-	if(!changed && ring.size() != 0){
-		for (int i = 0; i < ring.size(); i++){
-			if (curMemList[i].getHashCode() != ring[i].getHashCode()){
-				changed = true;
-				break;
-			}
+	while ( !memberNode->events.empty() ) {
+		MemberEvent &event = memberNode->events.front();
+		// suspects keep their place in the ring, only joins and deaths move it
+		if ( event.type == JOIN_EVENT ) {
+			changed = ringInsert(event.addr) || changed;
 		}
+		else if ( event.type == DEAD_EVENT ) {
+			changed = ringErase(event.addr) || changed;
+		}
+		memberNode->events.pop();
 	}
-	
+	ringEpoch = memberNode->epoch;
+
 	/*
 	 * Step 3: Run the stabilization protocol IF REQUIRED
 	 */
-	
-	// Run stabilization protocol if the hash table size is greater than zero and if there has been a changed in the ring
-
-	ring = curMemList;
 	if(changed){
 		stabilizationProtocol();
-	}	
+	}
 }
 
 /**
- * FUNCTION NAME: getMemberhipList
+ * FUNCTION NAME: ringInsert
+ *
+ * DESCRIPTION: Put a member at its place in the ring
  *
- * DESCRIPTION: This function goes through the membership list from the Membership protocol/MP1 and
- * 				i) generates the hash code for each member
- * 				ii) populates the ring member in MP2Node class
- * 				It returns a vector of Nodes. Each element in the vector contain the following fields:
- * 				a) Address of the node
- * 				b) Hash code obtained by consistent hashing of the Address
+ * RETURNS:
+ * false if it was in the ring already
  */
-vector<Node> MP2Node::getMembershipList() {
+bool MP2Node::ringInsert(Address &addr) {
+	Node node(addr);
+	vector<Node>::iterator it = lower_bound(ring.begin(), ring.end(), node);
+	for ( vector<Node>::iterator same = it; same != ring.end() && same->getHashCode() == node.getHashCode(); same++ ) {
+		if ( *same->getAddress() == addr ) {
+			return false;
+		}
+	}
+	ring.insert(it, node);
+	return true;
+}
 
-	unsigned int i;
-	vector<Node> curMemList;
-	for ( i = 0 ; i < this->memberNode->memberList.size(); i++ ) {
-		if (this->memberNode->memberList.at(i).getheartbeat() == HeartBeat::FAILED) {
-			continue;
+/**
+ * FUNCTION NAME: ringErase
+ *
+ * DESCRIPTION: Take a member out of the ring
+ *
+ * RETURNS:
+ * false if it was not in the ring
+ */
+bool MP2Node::ringErase(Address &addr) {
+	Node node(addr);
+	for ( vector<Node>::iterator it = lower_bound(ring.begin(), ring.end(), node); it != ring.end() && it->getHashCode() == node.getHashCode(); it++ ) {
+		if ( *it->getAddress() == addr ) {
+			ring.erase(it);
+			return true;
 		}
-		Address addressOfThisMember;
-		int id = this->memberNode->memberList.at(i).getid();
-		short port = this->memberNode->memberList.at(i).getport();
-		memcpy(&addressOfThisMember.addr[0], &id, sizeof(int));
-		memcpy(&addressOfThisMember.addr[4], &port, sizeof(short));
-		curMemList.push_back(Node(addressOfThisMember));
 	}
-	return curMemList;
+	return false;
 }
 
 /**
@@ -137,12 +138,11 @@ size_t MP2Node::hashFunction(string key) {
  */
 void MP2Node::clientCreate(string key, string value) {
 	vector<Node> replicas = findNodes(key);
+	vector<Address> replicaAddrs = getAddresses(replicas);
 	Transaction tr(MessageType::CREATE, this->par->getcurrtime(), key, value, false);
 	transactions[tr.ID] = tr;
-	for (int i = 0; i < replicas.size(); i++) {
-		Message msg(tr.ID, this->memberNode->addr, MessageType::CREATE, key, value);
-		emulNet->ENsend(&memberNode->addr, replicas[i].getAddress(), msg.toString());
-	}
+	Message msg(tr.ID, this->memberNode->addr, MessageType::CREATE, key, value);
+	emulNet->ENsendMulti(&memberNode->addr, replicaAddrs, msg.toString(), MP2_CHANNEL);
 }
 
 /**
@@ -157,12 +157,11 @@ void MP2Node::clientCreate(string key, string value) {
 void MP2Node::clientRead(string key){
 
 	vector<Node> replicas = findNodes(key);
+	vector<Address> replicaAddrs = getAddresses(replicas);
 	Transaction tr(MessageType::READ, this->par->getcurrtime(), key, "", false);
 	transactions[tr.ID] = tr;
-	for (int i =0; i < replicas.size(); i++) {
-		Message msg(tr.ID, this->memberNode->addr, MessageType::READ, key);
-		emulNet->ENsend(&memberNode->addr, replicas[i].getAddress(), msg.toString());
-	}
+	Message msg(tr.ID, this->memberNode->addr, MessageType::READ, key);
+	emulNet->ENsendMulti(&memberNode->addr, replicaAddrs, msg.toString(), MP2_CHANNEL);
 
 }
 
@@ -178,12 +177,11 @@ void MP2Node::clientRead(string key){
 void MP2Node::clientUpdate(string key, string value){
 	
 	vector<Node> replicas = findNodes(key);
+	vector<Address> replicaAddrs = getAddresses(replicas);
 	Transaction tr(MessageType::UPDATE, this->par->getcurrtime(), key, value, false);
 	transactions[tr.ID] = tr;
-	for (int i =0; i < replicas.size(); i++) {
-		Message msg(tr.ID, this->memberNode->addr, MessageType::UPDATE, key, value);
-		emulNet->ENsend(&memberNode->addr, replicas[i].getAddress(), msg.toString());
-	}
+	Message msg(tr.ID, this->memberNode->addr, MessageType::UPDATE, key, value);
+	emulNet->ENsendMulti(&memberNode->addr, replicaAddrs, msg.toString(), MP2_CHANNEL);
 }
 
 /**
@@ -197,12 +195,11 @@ void MP2Node::clientUpdate(string key, string value){
  */
 void MP2Node::clientDelete(string key){
 	vector<Node> replicas = findNodes(key);
+	vector<Address> replicaAddrs = getAddresses(replicas);
 	Transaction tr(MessageType::DELETE, this->par->getcurrtime(), key, "", false);
 	transactions[tr.ID] = tr;
-	for (int i =0; i < replicas.size(); i++) {
-		Message msg(tr.ID, this->memberNode->addr, MessageType::DELETE, key);
-		emulNet->ENsend(&memberNode->addr, replicas[i].getAddress(), msg.toString());
-	}
+	Message msg(tr.ID, this->memberNode->addr, MessageType::DELETE, key);
+	emulNet->ENsendMulti(&memberNode->addr, replicaAddrs, msg.toString(), MP2_CHANNEL);
 }
 
 /**
@@ -293,11 +290,11 @@ void MP2Node::sendReply(int transID, MessageType msgType, Address* toAddr, bool
 	MessageType replyMsgType = msgType == MessageType::READ ? MessageType::READREPLY : MessageType::REPLY;
 	if (replyMsgType == MessageType::READREPLY) {
 		string msg = Message(transID, memberNode->addr, value).toString();
-		emulNet->ENsend(&memberNode->addr, toAddr, msg);	
+		emulNet->ENsend(&memberNode->addr, toAddr, msg, MP2_CHANNEL);	
 	}
 	else{
 		string msg = Message(transID, this->memberNode->addr, replyMsgType, success).toString();
-		emulNet->ENsend(&memberNode->addr, toAddr, msg);
+		emulNet->ENsend(&memberNode->addr, toAddr, msg, MP2_CHANNEL);
 	}
 }
 
@@ -331,6 +328,7 @@ void MP2Node::checkMessages() {
 		memberNode->mp2q.pop();
 
 		string message(data, data + size);
+		emulNet->ENrelease(data);
 		Message msg(message);
 
 		switch (msg.type)
@@ -492,6 +490,19 @@ vector<Node> MP2Node::findNodes(string key) {
 	return addr_vec;
 }
 
+/**
+ * FUNCTION NAME: getAddresses
+ *
+ * DESCRIPTION: Addresses of the given nodes, in the same order
+ */
+vector<Address> MP2Node::getAddresses(vector<Node> &nodes) {
+	vector<Address> addrs;
+	for (unsigned int i = 0; i < nodes.size(); i++) {
+		addrs.push_back(*nodes[i].getAddress());
+	}
+	return addrs;
+}
+
 /**
  * FUNCTION NAME: recvLoop
  *
@@ -502,7 +513,7 @@ bool MP2Node::recvLoop() {
     	return false;
     }
     else {
-    	return emulNet->ENrecv(&(memberNode->addr), this->enqueueWrapper, NULL, 1, &(memberNode->mp2q));
+    	return emulNet->ENrecv(&(memberNode->addr), this->enqueueWrapper, NULL, 1, &(memberNode->mp2q), MP2_CHANNEL);
     }
 }
 
@@ -515,6 +526,45 @@ int MP2Node::enqueueWrapper(void *env, char *buff, int size) {
 	Queue q;
 	return q.enqueue((queue<q_elt> *)env, (void *)buff, size);
 }
+/**
+ * FUNCTION NAME: msgTypeOf
+ *
+ * DESCRIPTION: Message type of an MP2 payload, for the per type traffic accounting of EmulNet.
+ * 				Reads the third field of transID::fromAddr::type::... without building a Message.
+ */
+int MP2Node::msgTypeOf(char *data, int size) {
+	int fields = 0;
+	for ( int i = 0; i + 1 < size; i++ ) {
+		if ( data[i] == ':' && data[i + 1] == ':' ) {
+			if ( ++fields == 2 ) {
+				int type = 0, j;
+				for ( j = i + 2; j < size && data[j] >= '0' && data[j] <= '9'; j++ ) {
+					type = type * 10 + (data[j] - '0');
+				}
+				return j > i + 2 ? type : -1;
+			}
+			i++;
+		}
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: msgTypeNames
+ *
+ * DESCRIPTION: Names of the MP2 message types, indexed by MessageType
+ */
+vector<string> MP2Node::msgTypeNames() {
+	vector<string> names;
+	names.push_back("CREATE");
+	names.push_back("READ");
+	names.push_back("UPDATE");
+	names.push_back("DELETE");
+	names.push_back("REPLY");
+	names.push_back("READREPLY");
+	return names;
+}
+
 /**
  * FUNCTION NAME: stabilizationProtocol
  *
@@ -530,14 +580,13 @@ void MP2Node::stabilizationProtocol() {
 	for(auto entry: ht->hashTable) {
 
 		auto neighbours = findNodes(entry.first);
+		vector<Address> neighbourAddrs = getAddresses(neighbours);
 
-		for(auto node: neighbours) {
-			string key = entry.first, value = entry.second;
-			Transaction tr(STAB_TRANS, this->par->getcurrtime(), key, value, true);
-			transactions[tr.ID] = tr;
-			string message = Message(tr.ID, memberNode->addr, MessageType::CREATE, entry.first, entry.second).toString();
-			emulNet->ENsend(&memberNode->addr, node.getAddress(), message);
-		}
+		string key = entry.first, value = entry.second;
+		Transaction tr(STAB_TRANS, this->par->getcurrtime(), key, value, true);
+		transactions[tr.ID] = tr;
+		string message = Message(tr.ID, memberNode->addr, MessageType::CREATE, entry.first, entry.second).toString();
+		emulNet->ENsendMulti(&memberNode->addr, neighbourAddrs, message, MP2_CHANNEL);
 
 	}
 
@@ -69,6 +69,8 @@ private:
 	vector<Node> haveReplicasOf;
 	// Ring
 	vector<Node> ring;
+	// Member::epoch the ring is up to date with
+	long ringEpoch;
 	// Hash Table
 	HashTable * ht;
 	// Member repxresenting this member
@@ -89,7 +91,8 @@ public:
 
 	// ring functionalities
 	void updateRing();
-	vector<Node> getMembershipList();
+	bool ringInsert(Address &addr);
+	bool ringErase(Address &addr);
 	size_t hashFunction(string key);
 	void findNeighbors();
 
@@ -102,6 +105,8 @@ public:
 	// receive messages from Emulnet
 	bool recvLoop();
 	static int enqueueWrapper(void *env, char *buff, int size);
+	static int msgTypeOf(char *data, int size);
+	static vector<string> msgTypeNames();
 
 	// handle messages from receiving queue
 	void checkMessages();
@@ -111,6 +116,7 @@ public:
 
 	// find the addresses of nodes that are responsible for a key
 	vector<Node> findNodes(string key);
+	vector<Address> getAddresses(vector<Node> &nodes);
 
 	// server
 	bool createKeyValue(string key, string value, int transID);
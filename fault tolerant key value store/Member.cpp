@@ -38,12 +38,12 @@ bool Address::operator ==(const Address& anotherAddress) {
 /**
  * Constructor
  */
-MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), heartbeat(heartbeat), timestamp(timestamp) {}
+MemberListEntry::MemberListEntry(int id, short port, long heartbeat, long timestamp): id(id), port(port), heartbeat(heartbeat), timestamp(timestamp), updated(0), state(MEMBER_ALIVE), incarnation(0), arrivals(0), arrivalMean(0), arrivalVar(0) {}
 
 /**
  * Constuctor
  */
-MemberListEntry::MemberListEntry(int id, short port): id(id), port(port) {}
+MemberListEntry::MemberListEntry(int id, short port): id(id), port(port), updated(0), state(MEMBER_ALIVE), incarnation(0), arrivals(0), arrivalMean(0), arrivalVar(0) {}
 
 /**
  * Copy constructor
@@ -53,6 +53,12 @@ MemberListEntry::MemberListEntry(const MemberListEntry &anotherMLE) {
 	this->id = anotherMLE.id;
 	this->port = anotherMLE.port;
 	this->timestamp = anotherMLE.timestamp;
+	this->updated = anotherMLE.updated;
+	this->state = anotherMLE.state;
+	this->incarnation = anotherMLE.incarnation;
+	this->arrivals = anotherMLE.arrivals;
+	this->arrivalMean = anotherMLE.arrivalMean;
+	this->arrivalVar = anotherMLE.arrivalVar;
 }
 
 /**
@@ -64,6 +70,12 @@ MemberListEntry& MemberListEntry::operator =(const MemberListEntry &anotherMLE)
 	swap(id, temp.id);
 	swap(port, temp.port);
 	swap(timestamp, temp.timestamp);
+	swap(updated, temp.updated);
+	swap(state, temp.state);
+	swap(incarnation, temp.incarnation);
+	swap(arrivals, temp.arrivals);
+	swap(arrivalMean, temp.arrivalMean);
+	swap(arrivalVar, temp.arrivalVar);
 	return *this;
 }
 
@@ -155,6 +167,8 @@ Member::Member(const Member &anotherMember) {
 	this->myPos = anotherMember.myPos;
 	this->mp1q = anotherMember.mp1q;
 	this->mp2q = anotherMember.mp2q;
+	this->epoch = anotherMember.epoch;
+	this->events = anotherMember.events;
 }
 
 /**
@@ -173,5 +187,7 @@ Member& Member::operator =(const Member& anotherMember) {
 	this->myPos = anotherMember.myPos;
 	this->mp1q = anotherMember.mp1q;
 	this->mp2q = anotherMember.mp2q;
+	this->epoch = anotherMember.epoch;
+	this->events = anotherMember.events;
 	return *this;
 }
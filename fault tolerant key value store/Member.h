@@ -54,6 +54,16 @@ public:
 	}
 };
 
+/**
+ * Where a member stands in the eyes of a node. For the same incarnation a later state wins over an
+ * earlier one; only the member itself moves its incarnation, to refute a suspicion.
+ */
+enum MemberState {
+	MEMBER_ALIVE,
+	MEMBER_SUSPECT,
+	MEMBER_DEAD
+};
+
 /**
  * CLASS NAME: MemberListEntry
  *
@@ -65,9 +75,18 @@ public:
 	short port;
 	long heartbeat;
 	long timestamp;
+	// change sequence number of the owning node at the last change of this entry, see MP1Node::touch
+	long updated;
+	// MemberState and the incarnation it was set for
+	int state;
+	long incarnation;
+	// heartbeat intervals seen so far and their running mean and variance, see MP1Node::phi
+	long arrivals;
+	double arrivalMean;
+	double arrivalVar;
 	MemberListEntry(int id, short port, long heartbeat, long timestamp);
 	MemberListEntry(int id, short port);
-	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0) {}
+	MemberListEntry(): id(0), port(0), heartbeat(0), timestamp(0), updated(0), state(MEMBER_ALIVE), incarnation(0), arrivals(0), arrivalMean(0), arrivalVar(0) {}
 	MemberListEntry(const MemberListEntry &anotherMLE);
 	MemberListEntry& operator =(const MemberListEntry &anotherMLE);
 	int getid();
@@ -80,6 +99,30 @@ public:
 	void settimestamp(long timestamp);
 };
 
+/**
+ * Membership changes MP1 publishes for MP2, see Member::events
+ */
+enum MemberEventType {
+	JOIN_EVENT,		// a member is in the ring from now on: new, or back from the dead
+	SUSPECT_EVENT,
+	ALIVE_EVENT,	// a suspicion was refuted
+	DEAD_EVENT,		// a member is out of the ring from now on
+	REMOVE_EVENT	// a dead member was deleted from the membership list
+};
+
+/**
+ * CLASS NAME: MemberEvent
+ *
+ * DESCRIPTION: One change of the membership list, epoch is Member::epoch right after it
+ */
+class MemberEvent {
+public:
+	long epoch;
+	int type;
+	Address addr;
+	MemberEvent(long epoch, int type, const Address &addr): epoch(epoch), type(type), addr(addr) {}
+};
+
 /**
  * CLASS NAME: Member
  *
@@ -112,10 +155,14 @@ public:
 	queue<q_elt> mp1q;
 	// Queue for KVstore messages
 	queue<q_elt> mp2q;
+	// membership epoch, moves with every change of the membership list
+	long epoch;
+	// membership changes MP2 has not taken in yet
+	queue<MemberEvent> events;
 	/**
 	 * Constructor
 	 */
-	Member(): inited(false), inGroup(false), bFailed(false), nnb(0), heartbeat(0), pingCounter(0), timeOutCounter(0) {}
+	Member(): inited(false), inGroup(false), bFailed(false), nnb(0), heartbeat(0), pingCounter(0), timeOutCounter(0), epoch(0) {}
 	// copy constructor
 	Member(const Member &anotherMember);
 	// Assignment operator overloading
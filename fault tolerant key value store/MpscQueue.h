@@ -0,0 +1,82 @@
+/**********************************
+ * FILE NAME: MpscQueue.h
+ *
+ * DESCRIPTION: Lock-free multi-producer single-consumer queue
+ **********************************/
+
+#ifndef MPSCQUEUE_H_
+#define MPSCQUEUE_H_
+
+#include "stdincludes.h"
+#include <atomic>
+
+/**
+ * CLASS NAME: MpscQueue
+ *
+ * DESCRIPTION: Unbounded intrusive queue after D. Vyukov. Any number of threads may push,
+ * 				one thread pops. T must have an atomic<T *> next member; the queue never
+ * 				allocates, elements are linked through that member and stay owned by the caller.
+ * 				push is wait-free: one exchange and one store. pop may return NULL while a
+ * 				producer is half way through a push; the element shows up on a later pop.
+ * 				The queue holds its own stub element, so it must not be moved or copied
+ * 				while in use.
+ */
+template <typename T>
+class MpscQueue {
+private:
+	// last element pushed, where producers link in
+	atomic<T *> head;
+	char pad[64 - sizeof(atomic<T *>)];
+	// oldest element, only touched by the consumer
+	T *tail;
+	T stub;
+public:
+	MpscQueue(): head(&stub), tail(&stub) {
+		stub.next.store(NULL, memory_order_relaxed);
+	}
+	MpscQueue(const MpscQueue &) = delete;
+	MpscQueue& operator =(const MpscQueue &) = delete;
+
+	void push(T *elt) {
+		elt->next.store(NULL, memory_order_relaxed);
+		T *prev = head.exchange(elt, memory_order_acq_rel);
+		prev->next.store(elt, memory_order_release);
+	}
+
+	T *pop() {
+		T *first = tail;
+		T *next = first->next.load(memory_order_acquire);
+
+		if ( first == &stub ) {
+			if ( next == NULL ) {
+				return NULL;
+			}
+			tail = next;
+			first = next;
+			next = next->next.load(memory_order_acquire);
+		}
+		if ( next != NULL ) {
+			tail = next;
+			return first;
+		}
+		if ( first != head.load(memory_order_acquire) ) {
+			// a producer swapped head but has not linked its element yet
+			return NULL;
+		}
+		// first is the only element, put the stub behind it so it can be taken out
+		push(&stub);
+		next = first->next.load(memory_order_acquire);
+		if ( next != NULL ) {
+			tail = next;
+			return first;
+		}
+		return NULL;
+	}
+
+	// consumer side only; a push still in progress may not be seen yet
+	bool empty() {
+		return tail == &stub && stub.next.load(memory_order_acquire) == NULL;
+	}
+};
+
+#endif /* MPSCQUEUE_H_ */
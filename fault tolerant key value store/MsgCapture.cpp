@@ -0,0 +1,173 @@
+/**********************************
+ * FILE NAME: MsgCapture.cpp
+ *
+ * DESCRIPTION: Definition of the binary message trace writer and reader
+ **********************************/
+
+#include "MsgCapture.h"
+
+/**
+ * Constructor
+ */
+CaptureWriter::CaptureWriter(): fp(NULL), buff(NULL), records(0) {}
+
+/**
+ * Destructor
+ */
+CaptureWriter::~CaptureWriter() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Start a new trace at path
+ *
+ * RETURNS:
+ * true on success
+ */
+bool CaptureWriter::open(const char *path) {
+	close();
+
+	fp = fopen(path, "wb");
+	if ( fp == NULL ) {
+		return false;
+	}
+	buff = (char *) malloc(CAPTURE_BUFFSIZE);
+	setvbuf(fp, buff, _IOFBF, CAPTURE_BUFFSIZE);
+
+	cap_header hdr;
+	memcpy(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic));
+	hdr.version = CAPTURE_VERSION;
+	fwrite(&hdr, sizeof(hdr), 1, fp);
+	records = 0;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: write
+ *
+ * DESCRIPTION: Append one message
+ */
+void CaptureWriter::write(int tick, int from, int to, int channel, char *data, int size) {
+	cap_record rec;
+	rec.tick = tick;
+	rec.from = from;
+	rec.to = to;
+	rec.channel = channel;
+	rec.size = size;
+	fwrite(&rec, sizeof(rec), 1, fp);
+	fwrite(data, size, 1, fp);
+	records++;
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Flush and close the trace
+ */
+void CaptureWriter::close() {
+	if ( fp != NULL ) {
+		fclose(fp);
+		fp = NULL;
+	}
+	free(buff);
+	buff = NULL;
+}
+
+/**
+ * Constructor
+ */
+CaptureReader::CaptureReader(): base(NULL), length(0), offset(0) {}
+
+/**
+ * Destructor
+ */
+CaptureReader::~CaptureReader() {
+	close();
+}
+
+/**
+ * FUNCTION NAME: open
+ *
+ * DESCRIPTION: Map a trace file written by CaptureWriter
+ *
+ * RETURNS:
+ * true if the file is a trace this reader understands
+ */
+bool CaptureReader::open(const char *path) {
+	struct stat st;
+	cap_header hdr;
+
+	close();
+
+	int fd = ::open(path, O_RDONLY);
+	if ( fd < 0 ) {
+		return false;
+	}
+	if ( fstat(fd, &st) < 0 || st.st_size < (off_t) sizeof(cap_header) ) {
+		::close(fd);
+		return false;
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	::close(fd);
+	if ( map == MAP_FAILED ) {
+		return false;
+	}
+	base = (char *) map;
+	length = st.st_size;
+
+	memcpy(&hdr, base, sizeof(hdr));
+	if ( memcmp(hdr.magic, CAPTURE_MAGIC, sizeof(hdr.magic)) != 0 || hdr.version != CAPTURE_VERSION ) {
+		close();
+		return false;
+	}
+	madvise(base, length, MADV_SEQUENTIAL);
+	offset = sizeof(cap_header);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: next
+ *
+ * DESCRIPTION: Read the next message. data points into the mapping and stays valid until close.
+ *
+ * RETURNS:
+ * false at the end of the trace or on a truncated record
+ */
+bool CaptureReader::next(cap_record *rec, char **data) {
+	if ( base == NULL || offset + sizeof(cap_record) > length ) {
+		return false;
+	}
+	// records are packed back to back, so copy the header out instead of casting in place
+	memcpy(rec, base + offset, sizeof(cap_record));
+	if ( rec->size < 0 || offset + sizeof(cap_record) + rec->size > length ) {
+		return false;
+	}
+	*data = base + offset + sizeof(cap_record);
+	offset += sizeof(cap_record) + rec->size;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: rewind
+ *
+ * DESCRIPTION: Go back to the first message
+ */
+void CaptureReader::rewind() {
+	offset = sizeof(cap_header);
+}
+
+/**
+ * FUNCTION NAME: close
+ *
+ * DESCRIPTION: Unmap the trace
+ */
+void CaptureReader::close() {
+	if ( base != NULL ) {
+		munmap(base, length);
+		base = NULL;
+	}
+	length = 0;
+	offset = 0;
+}
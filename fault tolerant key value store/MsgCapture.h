@@ -0,0 +1,93 @@
+/**********************************
+ * FILE NAME: MsgCapture.h
+ *
+ * DESCRIPTION: Header file of the binary message trace writer and reader
+ **********************************/
+
+#ifndef MSGCAPTURE_H_
+#define MSGCAPTURE_H_
+
+#include "stdincludes.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Macros
+ */
+#define CAPTURE_MAGIC "ENTR"
+#define CAPTURE_VERSION 2
+// stdio buffer of the writer, traces are written in large blocks
+#define CAPTURE_BUFFSIZE (1 << 20)
+
+/**
+ * STRUCT NAME: cap_header
+ *
+ * DESCRIPTION: First bytes of a trace file
+ */
+typedef struct cap_header {
+	char magic[4];
+	int version;
+}cap_header;
+
+/**
+ * STRUCT NAME: cap_record
+ *
+ * DESCRIPTION: One sent message. The payload of size bytes follows the record.
+ * 				from and to are emulnet ids, channel is the EmulNet channel it was sent on.
+ */
+typedef struct cap_record {
+	int tick;
+	int from;
+	int to;
+	int channel;
+	int size;
+}cap_record;
+
+/**
+ * CLASS NAME: CaptureWriter
+ *
+ * DESCRIPTION: Appends sent messages to a trace file
+ */
+class CaptureWriter {
+private:
+	FILE *fp;
+	char *buff;
+	long records;
+public:
+	CaptureWriter();
+	CaptureWriter(const CaptureWriter &) = delete;
+	CaptureWriter& operator =(const CaptureWriter &) = delete;
+	bool open(const char *path);
+	bool isOpen() {
+		return fp != NULL;
+	}
+	void write(int tick, int from, int to, int channel, char *data, int size);
+	void close();
+	long getRecords() {
+		return records;
+	}
+	virtual ~CaptureWriter();
+};
+
+/**
+ * CLASS NAME: CaptureReader
+ *
+ * DESCRIPTION: Walks a trace file mapped into memory, without copying the payloads
+ */
+class CaptureReader {
+private:
+	char *base;
+	size_t length;
+	size_t offset;
+public:
+	CaptureReader();
+	CaptureReader(const CaptureReader &) = delete;
+	CaptureReader& operator =(const CaptureReader &) = delete;
+	bool open(const char *path);
+	bool next(cap_record *rec, char **data);
+	void rewind();
+	void close();
+	virtual ~CaptureReader();
+};
+
+#endif /* MSGCAPTURE_H_ */
@@ -0,0 +1,137 @@
+/**********************************
+ * FILE NAME: MsgPool.cpp
+ *
+ * DESCRIPTION: Definition of the size-class pool for EmulNet message buffers
+ **********************************/
+
+#include "MsgPool.h"
+
+/*
+ * Block sizes include the en_msg header.
+ * 64   : MP1 JOINREQ and MP2 READ/DELETE/REPLY text messages
+ * 256  : MP2 CREATE/UPDATE messages and gossip of small groups
+ * 1024 : gossip / JOINREP of up to ~200 members
+ * 4096 : anything up to MAX_MSG_SIZE
+ */
+static const int blockSizes[MSGPOOL_NUM_CLASSES] = { 64, 256, 1024, 4096 };
+
+/**
+ * Constructor
+ */
+MsgPool::MsgPool(): oversize(0) {
+	busy.clear();
+	for ( int i = 0; i < MSGPOOL_NUM_CLASSES; i++ ) {
+		classes[i].blockSize = blockSizes[i];
+		classes[i].freeList = NULL;
+		classes[i].hits = 0;
+		classes[i].misses = 0;
+		classes[i].inUse = 0;
+		classes[i].peakInUse = 0;
+	}
+}
+
+/**
+ * Destructor
+ */
+MsgPool::~MsgPool() {
+	for ( unsigned int i = 0; i < slabs.size(); i++ ) {
+		free(slabs[i]);
+	}
+}
+
+/**
+ * FUNCTION NAME: classOf
+ *
+ * DESCRIPTION: Smallest size class that fits size bytes
+ *
+ * RETURNS:
+ * class index, or -1 if the request is larger than every class
+ */
+int MsgPool::classOf(int size) {
+	for ( int i = 0; i < MSGPOOL_NUM_CLASSES; i++ ) {
+		if ( size <= classes[i].blockSize ) {
+			return i;
+		}
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: refill
+ *
+ * DESCRIPTION: Carve a new slab into blocks and thread them onto the free list
+ */
+void MsgPool::refill(SizeClass *sc) {
+	char *slab = (char *) malloc(sc->blockSize * MSGPOOL_SLAB_BLOCKS);
+	slabs.push_back(slab);
+	for ( int i = MSGPOOL_SLAB_BLOCKS - 1; i >= 0; i-- ) {
+		char *block = slab + i * sc->blockSize;
+		*(void **)block = sc->freeList;
+		sc->freeList = block;
+	}
+}
+
+/**
+ * FUNCTION NAME: allocate
+ *
+ * DESCRIPTION: Hand out a block of at least size bytes
+ */
+void *MsgPool::allocate(int size) {
+	int cls = classOf(size);
+	if ( cls < 0 ) {
+		lock();
+		oversize++;
+		unlock();
+		return malloc(size);
+	}
+
+	SizeClass *sc = &classes[cls];
+	lock();
+	if ( sc->freeList == NULL ) {
+		sc->misses++;
+		refill(sc);
+	}
+	else {
+		sc->hits++;
+	}
+
+	void *block = sc->freeList;
+	sc->freeList = *(void **)block;
+	if ( ++sc->inUse > sc->peakInUse ) {
+		sc->peakInUse = sc->inUse;
+	}
+	unlock();
+	return block;
+}
+
+/**
+ * FUNCTION NAME: release
+ *
+ * DESCRIPTION: Give back a block obtained from allocate() with the same size
+ */
+void MsgPool::release(void *ptr, int size) {
+	int cls = classOf(size);
+	if ( cls < 0 ) {
+		free(ptr);
+		return;
+	}
+
+	SizeClass *sc = &classes[cls];
+	lock();
+	*(void **)ptr = sc->freeList;
+	sc->freeList = ptr;
+	sc->inUse--;
+	unlock();
+}
+
+/**
+ * FUNCTION NAME: printStats
+ *
+ * DESCRIPTION: Dump hit, miss and occupancy counters of every size class
+ */
+void MsgPool::printStats(FILE *file) {
+	for ( int i = 0; i < MSGPOOL_NUM_CLASSES; i++ ) {
+		fprintf(file, "class %4d B hits %8ld misses %6ld in_use %6ld peak %6ld\n", classes[i].blockSize, classes[i].hits, classes[i].misses, classes[i].inUse, classes[i].peakInUse);
+	}
+	fprintf(file, "oversize %ld\n", oversize);
+}
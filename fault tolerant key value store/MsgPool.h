@@ -0,0 +1,90 @@
+/**********************************
+ * FILE NAME: MsgPool.h
+ *
+ * DESCRIPTION: Header file of the size-class pool for EmulNet message buffers
+ **********************************/
+
+#ifndef MSGPOOL_H_
+#define MSGPOOL_H_
+
+#include "stdincludes.h"
+#include <atomic>
+
+/*
+ * Macros
+ */
+// number of size classes served from the pool
+#define MSGPOOL_NUM_CLASSES 4
+// number of blocks carved out of each slab
+#define MSGPOOL_SLAB_BLOCKS 64
+
+/**
+ * STRUCT NAME: SizeClass
+ *
+ * DESCRIPTION: Free list and usage counters of one block size
+ */
+typedef struct SizeClass {
+	int blockSize;
+	void *freeList;
+	long hits;
+	long misses;
+	long inUse;
+	long peakInUse;
+}SizeClass;
+
+/**
+ * CLASS NAME: MsgPool
+ *
+ * DESCRIPTION: Slab allocator with a small set of fixed block sizes.
+ * 				Blocks are handed out by allocate() and must be given back through
+ * 				release() with the same size. Requests larger than the biggest class
+ * 				fall through to malloc and are counted as misses.
+ * 				allocate() and release() may be called from any thread; a spinlock guards
+ * 				the free lists, it is held for a few instructions only.
+ */
+class MsgPool {
+private:
+	SizeClass classes[MSGPOOL_NUM_CLASSES];
+	vector<char *> slabs;
+	long oversize;
+	atomic_flag busy;
+	void lock() {
+		while ( busy.test_and_set(memory_order_acquire) ) {}
+	}
+	void unlock() {
+		busy.clear(memory_order_release);
+	}
+	int classOf(int size);
+	void refill(SizeClass *sc);
+public:
+	MsgPool();
+	MsgPool(const MsgPool &anotherPool) = delete;
+	MsgPool& operator = (const MsgPool &anotherPool) = delete;
+	virtual ~MsgPool();
+	void *allocate(int size);
+	void release(void *ptr, int size);
+	int getNumClasses() {
+		return MSGPOOL_NUM_CLASSES;
+	}
+	int getBlockSize(int cls) {
+		return classes[cls].blockSize;
+	}
+	long getHits(int cls) {
+		return classes[cls].hits;
+	}
+	long getMisses(int cls) {
+		return classes[cls].misses;
+	}
+	long getInUse(int cls) {
+		return classes[cls].inUse;
+	}
+	long getPeakInUse(int cls) {
+		return classes[cls].peakInUse;
+	}
+	long getOversize() {
+		return oversize;
+	}
+	void printStats(FILE *file);
+};
+
+#endif /* MSGPOOL_H_ */
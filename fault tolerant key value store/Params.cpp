@@ -27,6 +27,32 @@ void Params::setparams(char *config_file) {
 	fscanf(fp,"\nMSG_DROP_PROB: %lf", &MSG_DROP_PROB);
 	fscanf(fp,"\nCRUD_TEST: %s", CRUD);
 
+	/*
+	 * Optional settings follow as "KEY: value" lines in any order
+	 */
+	LINK_LATENCY = 0;
+	LINK_JITTER = 0;
+	// not given yet, see resolveLinkDist
+	LINK_DIST = -1;
+	NODE_BANDWIDTH = 0;
+	SEND_CREDITS = 0;
+	LINKS.clear();
+	TRANSPORT = EMUL_TRANSPORT;
+	PROCESSES = 0;
+	FAULTS.clear();
+	CAPTURE.clear();
+	REPLAY.clear();
+	DETECTOR = HEARTBEAT_DETECTOR;
+	PHI_THRESHOLD = 8;
+	PHI_REPORT = 0;
+	SEEDS.clear();
+	char key[64];
+	char value[256];
+	while ( fscanf(fp, " %63[^:]: %255[^\r\n]", key, value) == 2 ) {
+		setoption(key, value);
+	}
+	resolveLinkDist();
+
 	if ( 0 == strcmp(CRUD, "CREATE") ) {
 		this->CRUDTEST = CREATE_TEST;
 	}
@@ -40,6 +66,19 @@ void Params::setparams(char *config_file) {
 		this->CRUDTEST = DELETE_TEST;
 	}
 
+	// introducers have to be nodes of the group, node 1 is the one by default
+	for ( unsigned int i = 0; i < SEEDS.size(); ) {
+		if ( SEEDS[i] < 1 || SEEDS[i] > MAX_NNB ) {
+			SEEDS.erase(SEEDS.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+	if ( SEEDS.empty() ) {
+		SEEDS.push_back(1);
+	}
+
 	//printf("Parameters of the test case: %d %d %d %lf\n", MAX_NNB, SINGLE_FAILURE, DROP_MSG, MSG_DROP_PROB);
 
 	EN_GPSZ = MAX_NNB;
@@ -56,6 +95,185 @@ void Params::setparams(char *config_file) {
 	return;
 }
 
+/**
+ * FUNCTION NAME: parseIdSet
+ *
+ * DESCRIPTION: Parse a comma separated list of emulnet ids and id ranges, e.g. "1-3,7"
+ */
+static void parseIdSet(char *str, vector<int> &ids) {
+	char *save;
+	for ( char *tok = strtok_r(str, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save) ) {
+		int first, last;
+		int n = sscanf(tok, "%d-%d", &first, &last);
+		if ( n == 1 ) {
+			ids.push_back(first);
+		}
+		else if ( n == 2 ) {
+			for ( int id = first; id <= last; id++ ) {
+				ids.push_back(id);
+			}
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: parseLinkDist
+ *
+ * DESCRIPTION: Parse the name of a latencyDIST
+ *
+ * RETURNS:
+ * the distribution, -1 if the name is not known
+ */
+static int parseLinkDist(const char *name) {
+	if ( 0 == strcmp(name, "CONST") ) {
+		return CONST_LATENCY;
+	}
+	else if ( 0 == strcmp(name, "UNIFORM") ) {
+		return UNIFORM_LATENCY;
+	}
+	else if ( 0 == strcmp(name, "EXP") ) {
+		return EXP_LATENCY;
+	}
+	return -1;
+}
+
+/**
+ * FUNCTION NAME: resolveLinkDist
+ *
+ * DESCRIPTION: Pick the latency distribution of the links that were not given one: LINK_DIST,
+ * 				or UNIFORM where there is jitter to spread, since a constant delay has none.
+ * 				Jitter asked for explicitly with CONST would be silently ignored, so it is rejected.
+ */
+void Params::resolveLinkDist() {
+	bool givenConst = ( LINK_DIST == CONST_LATENCY );
+
+	if ( LINK_DIST < 0 ) {
+		LINK_DIST = ( LINK_JITTER > 0 ) ? UNIFORM_LATENCY : CONST_LATENCY;
+	}
+	if ( givenConst && LINK_JITTER > 0 ) {
+		printf("LINK_JITTER %d needs LINK_DIST UNIFORM or EXP, CONST has no jitter\n", LINK_JITTER);
+		exit(1);
+	}
+	for ( unsigned int i = 0; i < LINKS.size(); i++ ) {
+		LinkSpec &link = LINKS[i];
+		if ( link.dist < 0 ) {
+			link.dist = ( LINK_DIST == CONST_LATENCY && link.jitter > 0 ) ? UNIFORM_LATENCY : LINK_DIST;
+		}
+		else if ( link.dist == CONST_LATENCY && link.jitter > 0 ) {
+			printf("LINK %d %d: jitter %d needs UNIFORM or EXP, CONST has no jitter\n", link.from, link.to, link.jitter);
+			exit(1);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: setoption
+ *
+ * DESCRIPTION: Set one optional parameter of this test case
+ */
+void Params::setoption(char *key, char *value) {
+	if ( 0 == strcmp(key, "LINK_LATENCY") ) {
+		LINK_LATENCY = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "LINK_JITTER") ) {
+		LINK_JITTER = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "LINK_DIST") ) {
+		// an unknown name leaves the choice to resolveLinkDist
+		LINK_DIST = parseLinkDist(value);
+	}
+	else if ( 0 == strcmp(key, "NODE_BANDWIDTH") ) {
+		NODE_BANDWIDTH = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "SEND_CREDITS") ) {
+		SEND_CREDITS = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "CAPTURE") ) {
+		CAPTURE = value;
+	}
+	else if ( 0 == strcmp(key, "REPLAY") ) {
+		REPLAY = value;
+	}
+	else if ( 0 == strcmp(key, "TRANSPORT") ) {
+		if ( 0 == strcmp(value, "UDP") ) {
+			TRANSPORT = UDP_TRANSPORT;
+		}
+		else if ( 0 == strcmp(value, "SHM") ) {
+			TRANSPORT = SHM_TRANSPORT;
+		}
+		else {
+			TRANSPORT = EMUL_TRANSPORT;
+		}
+	}
+	else if ( 0 == strcmp(key, "PROCESSES") ) {
+		PROCESSES = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "FAILURE_DETECTOR") ) {
+		if ( 0 == strcmp(value, "SWIM") ) {
+			DETECTOR = SWIM_DETECTOR;
+		}
+		else {
+			DETECTOR = HEARTBEAT_DETECTOR;
+		}
+	}
+	else if ( 0 == strcmp(key, "PHI_THRESHOLD") ) {
+		PHI_THRESHOLD = atof(value);
+	}
+	else if ( 0 == strcmp(key, "PHI_REPORT") ) {
+		PHI_REPORT = atoi(value);
+	}
+	else if ( 0 == strcmp(key, "SEEDS") ) {
+		// SEEDS: <ids>
+		SEEDS.clear();
+		parseIdSet(value, SEEDS);
+	}
+	else if ( 0 == strcmp(key, "PARTITION") ) {
+		// PARTITION: <start> <heal> <ids> [| <ids>]
+		FaultSpec fault;
+		int used = 0;
+		fault.type = PARTITION_FAULT;
+		fault.from = fault.to = 0;
+		fault.dropProb = 1;
+		if ( sscanf(value, "%d %d %n", &fault.start, &fault.end, &used) == 2 ) {
+			char *groups = value + used;
+			char *bar = strchr(groups, '|');
+			if ( bar != NULL ) {
+				*bar = 0;
+				parseIdSet(bar + 1, fault.groupB);
+			}
+			parseIdSet(groups, fault.groupA);
+			FAULTS.push_back(fault);
+		}
+	}
+	else if ( 0 == strcmp(key, "CUT") ) {
+		// CUT: <start> <heal> <from id> <to id>
+		FaultSpec fault;
+		fault.type = CUT_FAULT;
+		fault.dropProb = 1;
+		if ( sscanf(value, "%d %d %d %d", &fault.start, &fault.end, &fault.from, &fault.to) == 4 ) {
+			FAULTS.push_back(fault);
+		}
+	}
+	else if ( 0 == strcmp(key, "LINK_DROP") ) {
+		// LINK_DROP: <start> <heal> <from id> <to id> <probability>
+		FaultSpec fault;
+		fault.type = DROP_FAULT;
+		if ( sscanf(value, "%d %d %d %d %lf", &fault.start, &fault.end, &fault.from, &fault.to, &fault.dropProb) == 5 ) {
+			FAULTS.push_back(fault);
+		}
+	}
+	else if ( 0 == strcmp(key, "LINK") ) {
+		// LINK: <from id> <to id> <latency> <jitter> [CONST|UNIFORM|EXP], LINK_DIST when left out
+		LinkSpec link;
+		char dist[16];
+		int n = sscanf(value, "%d %d %d %d %15s", &link.from, &link.to, &link.latency, &link.jitter, dist);
+		if ( n >= 4 ) {
+			link.dist = ( n == 5 ) ? parseLinkDist(dist) : -1;
+			LINKS.push_back(link);
+		}
+	}
+}
+
 /**
  * FUNCTION NAME: getcurrtime
  *
@@ -12,6 +12,45 @@
 #include "Member.h"
 
 enum testTYPE { CREATE_TEST, READ_TEST, UPDATE_TEST, DELETE_TEST };
+enum latencyDIST { CONST_LATENCY, UNIFORM_LATENCY, EXP_LATENCY };
+enum transportTYPE { EMUL_TRANSPORT, UDP_TRANSPORT, SHM_TRANSPORT };
+enum faultTYPE { PARTITION_FAULT, CUT_FAULT, DROP_FAULT };
+enum detectorTYPE { HEARTBEAT_DETECTOR, SWIM_DETECTOR };
+
+/**
+ * STRUCT NAME: LinkSpec
+ *
+ * DESCRIPTION: Latency override for the directed link between two emulnet ids
+ */
+typedef struct LinkSpec {
+	int from;
+	int to;
+	int latency;
+	int jitter;
+	// latencyDIST the delay is drawn from
+	int dist;
+}LinkSpec;
+
+/**
+ * STRUCT NAME: FaultSpec
+ *
+ * DESCRIPTION: One entry of the fault schedule.
+ * 				PARTITION_FAULT: no traffic between groupA and groupB in either direction,
+ * 								 an empty groupB stands for every node outside groupA
+ * 				CUT_FAULT:		 no traffic from -> to (the reverse direction still works)
+ * 				DROP_FAULT:		 traffic from -> to is dropped with probability dropProb
+ * 				An id of 0 in from/to matches any node.
+ */
+typedef struct FaultSpec {
+	int type;
+	int start;			// first time unit the fault is in effect
+	int end;			// time unit the network heals at, -1 for never
+	vector<int> groupA;
+	vector<int> groupB;
+	int from;
+	int to;
+	double dropProb;
+}FaultSpec;
 
 /**
  * CLASS NAME: Params
@@ -32,8 +71,25 @@ public:
 	int allNodesJoined;
 	short PORTNUM;
 	int CRUDTEST;
+	int LINK_LATENCY;			// extra delivery delay of every link, in time units
+	int LINK_JITTER;			// spread of the delay around LINK_LATENCY
+	int LINK_DIST;				// distribution the delay is drawn from, UNIFORM by default when there is jitter
+	int NODE_BANDWIDTH;			// bytes a node can put on the wire per time unit, 0 is unlimited
+	int SEND_CREDITS;			// messages a node may have in flight per channel before further sends wait, 0 is unlimited
+	vector<LinkSpec> LINKS;		// per link overrides of LINK_LATENCY/LINK_JITTER
+	int TRANSPORT;				// emulated network, real UDP sockets on loopback or shared memory
+	int PROCESSES;				// processes the nodes are spread over with the shared memory transport
+	vector<FaultSpec> FAULTS;	// partitions and link faults to inject
+	string CAPTURE;				// record sent messages of both channels to the file CAPTURE
+	string REPLAY;				// trace to replay into the message handlers instead of running the test
+	int DETECTOR;				// failure detector of MP1: heartbeat gossip or SWIM probing
+	double PHI_THRESHOLD;		// suspicion level a member is declared failed at, 0 for the fixed TFAIL timeout
+	int PHI_REPORT;				// write the suspicion level of every member to phi.log every PHI_REPORT time units, 0 is off
+	vector<int> SEEDS;			// emulnet ids of the introducers, the first one boots the group
 	Params();
 	void setparams(char *);
+	void setoption(char *key, char *value);
+	void resolveLinkDist();
 	int getcurrtime();
 };
 
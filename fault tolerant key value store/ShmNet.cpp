@@ -0,0 +1,235 @@
+/**********************************
+ * FILE NAME: ShmNet.cpp
+ *
+ * DESCRIPTION: Shared memory multi-process transport definition
+ **********************************/
+
+#include "ShmNet.h"
+
+/**
+ * Constructor
+ * parties is the number of processes that meet at endTick
+ */
+ShmNet::ShmNet(Params *p, int parties): EmulNet(p), ringFull(0) {
+	static int instances = 0;
+	char name[64];
+	pthread_barrierattr_t attr;
+
+	sprintf(name, "/emulnet.%d.%d", (int) getpid(), instances++);
+	length = sizeof(shm_header) + (par->EN_GPSZ + 1) * EN_CHANNELS * sizeof(shm_ring);
+
+	int fd = shm_open(name, O_RDWR | O_CREAT | O_EXCL, 0600);
+	if ( fd < 0 ) {
+		perror("ShmNet shm_open");
+		exit(1);
+	}
+	if ( ftruncate(fd, length) < 0 ) {
+		perror("ShmNet ftruncate");
+		exit(1);
+	}
+	void *map = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	shm_unlink(name);
+	if ( map == MAP_FAILED ) {
+		perror("ShmNet mmap");
+		exit(1);
+	}
+
+	hdr = (shm_header *) map;
+	rings = (shm_ring *) (hdr + 1);
+	hdr->nodes = par->EN_GPSZ;
+	pthread_barrierattr_init(&attr);
+	pthread_barrierattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_barrier_init(&hdr->barrier, &attr, parties);
+	pthread_barrierattr_destroy(&attr);
+
+	for ( int i = 0; i < (hdr->nodes + 1) * EN_CHANNELS; i++ ) {
+		new (&rings[i].tail) atomic<long>(0);
+		rings[i].head = 0;
+		for ( long j = 0; j < SHM_SLOTS; j++ ) {
+			new (&rings[i].slots[j].seq) atomic<long>(j);
+		}
+	}
+}
+
+/**
+ * Destructor
+ */
+ShmNet::~ShmNet() {
+	munmap(hdr, length);
+}
+
+/**
+ * FUNCTION NAME: push
+ *
+ * DESCRIPTION: Copy a message into the next free slot of a ring
+ *
+ * RETURNS:
+ * false if the ring is full
+ */
+bool ShmNet::push(shm_ring *ring, int from, char *data, int size) {
+	long pos = ring->tail.load(memory_order_relaxed);
+	shm_slot *slot;
+
+	for ( ;; ) {
+		slot = &ring->slots[pos & (SHM_SLOTS - 1)];
+		long diff = slot->seq.load(memory_order_acquire) - pos;
+		if ( diff == 0 ) {
+			if ( ring->tail.compare_exchange_weak(pos, pos + 1, memory_order_relaxed) ) {
+				break;
+			}
+		}
+		else if ( diff < 0 ) {
+			// the consumer has not freed this slot since the last lap
+			return false;
+		}
+		else {
+			pos = ring->tail.load(memory_order_relaxed);
+		}
+	}
+
+	slot->size = size;
+	slot->from = from;
+	memcpy(slot->data, data, size);
+	slot->seq.store(pos + 1, memory_order_release);
+	return true;
+}
+
+/**
+ * FUNCTION NAME: pop
+ *
+ * DESCRIPTION: Take the oldest message out of a ring into a pool buffer
+ *
+ * RETURNS:
+ * false if the ring is empty
+ */
+bool ShmNet::pop(shm_ring *ring, en_msg **em) {
+	shm_slot *slot = &ring->slots[ring->head & (SHM_SLOTS - 1)];
+
+	if ( slot->seq.load(memory_order_acquire) != ring->head + 1 ) {
+		return false;
+	}
+
+	// value-initialised, so the port of from is zero
+	en_msg *msg = new (pool.allocate(sizeof(en_msg) + slot->size)) en_msg();
+	msg->size = slot->size;
+	msg->refs = 1;
+	memcpy(msg->from.addr, &slot->from, sizeof(int));
+	memcpy((char *)(msg + 1), slot->data, slot->size);
+
+	slot->seq.store(ring->head + SHM_SLOTS, memory_order_release);
+	ring->head++;
+	*em = msg;
+	return true;
+}
+
+/**
+ * FUNCTION NAME: ENsendMulti
+ *
+ * DESCRIPTION: Copy the message into the ring of every destination.
+ * 				Message drops and injected faults apply as with EmulNet, the link model
+ * 				and flow control do not: a full ring is the only limit.
+ *
+ * RETURNS:
+ * size if at least one destination got the message, 0 otherwise
+ */
+int ShmNet::ENsendMulti(Address *myaddr, Address *toaddrs, int count, char *data, int size, int channel, int *status) {
+	int src = *(int *)(myaddr->addr);
+	int time = par->getcurrtime();
+	int type = msgType(channel, data, size);
+	bool sent = false;
+
+	for ( int i = 0; status != NULL && i < count; i++ ) {
+		status[i] = EN_DROPPED;
+	}
+	lastSendStatus = EN_DROPPED;
+
+	if ( size > SHM_SLOT_SIZE || size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE ) {
+		return 0;
+	}
+
+	for ( int i = 0; i < count; i++ ) {
+		int dst = *(int *)(toaddrs[i].addr);
+		int sendmsg = rand() % 100;
+
+		lastSendStatus = EN_DROPPED;
+
+		if ( dst < 0 || dst > hdr->nodes ) {
+			continue;
+		}
+		if ( par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100) ) {
+			continue;
+		}
+		if ( faults.isEnabled() && faults.blocks(src, dst, time) ) {
+			continue;
+		}
+		if ( !push(ringOf(dst, channel), src, data, size) ) {
+			ringFull++;
+			continue;
+		}
+		if ( capture.isOpen() ) {
+			capture.write(time, src, dst, channel, data, size);
+		}
+
+		sent = true;
+		lastSendStatus = EN_SENT;
+		if ( status != NULL ) {
+			status[i] = EN_SENT;
+		}
+		sent_msgs.incr(src, time);
+		traffic.sent(src, time, type, size);
+	}
+
+	return sent ? size : 0;
+}
+
+/**
+ * FUNCTION NAME: ENrecv
+ *
+ * DESCRIPTION: Drain the ring of this node on channel. Every message is copied once into a pool buffer
+ * 				that the consumer gives back through ENrelease, as with EmulNet.
+ *
+ * RETURN:
+ * 0
+ */
+int ShmNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue, int channel) {
+	int dst = *(int *)(myaddr->addr);
+	int time = par->getcurrtime();
+	en_msg *em;
+
+	if ( dst < 0 || dst > hdr->nodes ) {
+		return 0;
+	}
+
+	while ( pop(ringOf(dst, channel), &em) ) {
+		memcpy(&(em->to.addr), &(myaddr->addr), sizeof(em->to.addr));
+		(*enq)(queue, (char *)(em+1), em->size);
+
+		recv_msgs.incr(dst, time);
+		traffic.received(dst, time, msgType(channel, (char *)(em+1), em->size), em->size);
+	}
+
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: endTick
+ *
+ * DESCRIPTION: Wait until every process is done with the current time unit.
+ * 				Sends made before the barrier are visible to all receives after it.
+ */
+void ShmNet::endTick() {
+	pthread_barrier_wait(&hdr->barrier);
+}
+
+/**
+ * FUNCTION NAME: ENcleanup
+ *
+ * DESCRIPTION: Write the usual logs of this process
+ */
+int ShmNet::ENcleanup() {
+	if ( ringFull > 0 ) {
+		cout<<"ShmNet: "<<ringFull<<" messages dropped on full mailboxes"<<endl;
+	}
+	return EmulNet::ENcleanup();
+}
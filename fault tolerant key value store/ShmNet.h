@@ -0,0 +1,98 @@
+/**********************************
+ * FILE NAME: ShmNet.h
+ *
+ * DESCRIPTION: Shared memory multi-process transport header file
+ **********************************/
+
+#ifndef _SHMNET_H_
+#define _SHMNET_H_
+
+#include "stdincludes.h"
+#include "EmulNet.h"
+#include <atomic>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+/*
+ * Macros
+ */
+// messages a node mailbox holds, a power of two
+#define SHM_SLOTS 256
+// largest payload a slot takes
+#define SHM_SLOT_SIZE 4000
+#define SHM_CACHELINE 64
+
+/**
+ * Struct Name: shm_slot
+ *
+ * DESCRIPTION: One message in a mailbox ring. seq tells producers and the consumer whose turn it is:
+ * 				pos when the slot is free for the producer claiming position pos,
+ * 				pos + 1 once that producer has filled it.
+ */
+typedef struct shm_slot {
+	atomic<long> seq;
+	int size;
+	int from;
+	char data[SHM_SLOT_SIZE];
+}shm_slot;
+
+/**
+ * Struct Name: shm_ring
+ *
+ * DESCRIPTION: Bounded mailbox of one node, many producers and a single consumer.
+ * 				Producers claim positions on tail, only the owner moves head.
+ */
+typedef struct shm_ring {
+	atomic<long> tail;
+	char pad1[SHM_CACHELINE - sizeof(atomic<long>)];
+	long head;
+	char pad2[SHM_CACHELINE - sizeof(long)];
+	shm_slot slots[SHM_SLOTS];
+}shm_ring;
+
+/**
+ * Struct Name: shm_header
+ *
+ * DESCRIPTION: Start of the segment, followed by one shm_ring per emulnet id and channel
+ */
+typedef struct shm_header {
+	int nodes;
+	pthread_barrier_t barrier;
+}shm_header;
+
+/**
+ * CLASS NAME: ShmNet
+ *
+ * DESCRIPTION: Transport with the EmulNet contract for nodes running in separate processes.
+ * 				Every node has a ring mailbox per channel in a POSIX shared memory segment. The segment is created
+ * 				and mapped before the processes are forked, so all of them share it; its name is
+ * 				unlinked right away and nothing is left behind when they exit.
+ * 				A send copies the payload into a slot of every destination ring, a receive copies it
+ * 				out into a pool buffer. A full ring drops the message.
+ * 				endTick is the barrier that keeps the processes on the same time unit.
+ */
+class ShmNet : public EmulNet
+{
+private:
+	shm_header *hdr;
+	shm_ring *rings;
+	size_t length;
+	// sends dropped because the destination ring was full
+	long ringFull;
+	bool push(shm_ring *ring, int from, char *data, int size);
+	bool pop(shm_ring *ring, en_msg **em);
+	shm_ring *ringOf(int id, int channel) {
+		return &rings[id * EN_CHANNELS + channel];
+	}
+public:
+	ShmNet(Params *p, int parties);
+	virtual ~ShmNet();
+	using EmulNet::ENsendMulti;
+	int ENsendMulti(Address *myaddr, Address *toaddrs, int count, char *data, int size, int channel, int *status = NULL);
+	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue, int channel);
+	int ENcleanup();
+	void endTick();
+};
+
+#endif /* _SHMNET_H_ */
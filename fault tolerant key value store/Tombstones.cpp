@@ -0,0 +1,114 @@
+/**********************************
+ * FILE NAME: Tombstones.cpp
+ *
+ * DESCRIPTION: Definition of the tombstone store of dead members
+ **********************************/
+
+#include "Tombstones.h"
+
+/**
+ * Constructor
+ * A tombstone lives for count buckets of width time units
+ */
+TombstoneStore::TombstoneStore(int count, int width): buckets(count), width(width), current(0) {}
+
+/**
+ * FUNCTION NAME: bury
+ *
+ * DESCRIPTION: Remember that a member died at incarnation, or bury it again with the time
+ * 				starting over. A tombstone of a higher incarnation is left alone.
+ */
+void TombstoneStore::bury(long key, long incarnation, long updated, long time) {
+	expire(time);
+
+	map<long, Tombstone>::iterator it = graves.find(key);
+	if ( it != graves.end() && it->second.incarnation > incarnation ) {
+		return;
+	}
+	Tombstone &grave = graves[key];
+	grave.incarnation = incarnation;
+	grave.updated = updated;
+	grave.bucket = current;
+	buckets[current % buckets.size()].push_back(key);
+}
+
+/**
+ * FUNCTION NAME: covers
+ *
+ * DESCRIPTION: Tells whether news about a member at incarnation is older than its death
+ *
+ * RETURNS:
+ * true if the member is buried at incarnation or a higher one
+ */
+bool TombstoneStore::covers(long key, long incarnation) {
+	map<long, Tombstone>::iterator it = graves.find(key);
+	return it != graves.end() && it->second.incarnation >= incarnation;
+}
+
+/**
+ * FUNCTION NAME: lift
+ *
+ * DESCRIPTION: Forget a member that came back with a higher incarnation.
+ * 				Its key stays in its bucket and is skipped when the bucket expires.
+ */
+void TombstoneStore::lift(long key) {
+	graves.erase(key);
+}
+
+/**
+ * FUNCTION NAME: incarnationOf
+ *
+ * DESCRIPTION: Incarnation a member died at, -1 if it is not buried
+ */
+long TombstoneStore::incarnationOf(long key) {
+	map<long, Tombstone>::iterator it = graves.find(key);
+	return it != graves.end() ? it->second.incarnation : -1;
+}
+
+/**
+ * FUNCTION NAME: expire
+ *
+ * DESCRIPTION: Move on to the bucket of time, dropping the buckets that fall out of the window
+ */
+void TombstoneStore::expire(long time) {
+	long bucket = time / width;
+	long count = buckets.size();
+
+	if ( bucket - current > count ) {
+		current = bucket - count;
+	}
+	while ( current < bucket ) {
+		current++;
+		// the slot of the new bucket still holds the one count buckets back
+		expireBucket(current - count);
+	}
+}
+
+/**
+ * FUNCTION NAME: expireBucket
+ *
+ * DESCRIPTION: Drop the tombstones of bucket, except those buried again since
+ */
+void TombstoneStore::expireBucket(long bucket) {
+	vector<long> &keys = buckets[(bucket + buckets.size()) % buckets.size()];
+
+	for ( long key : keys ) {
+		map<long, Tombstone>::iterator it = graves.find(key);
+		if ( it != graves.end() && it->second.bucket <= bucket ) {
+			graves.erase(it);
+		}
+	}
+	keys.clear();
+}
+
+/**
+ * FUNCTION NAME: clear
+ *
+ * DESCRIPTION: Forget every tombstone
+ */
+void TombstoneStore::clear() {
+	graves.clear();
+	for ( vector<long> &keys : buckets ) {
+		keys.clear();
+	}
+}
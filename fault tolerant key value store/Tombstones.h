@@ -0,0 +1,63 @@
+/**********************************
+ * FILE NAME: Tombstones.h
+ *
+ * DESCRIPTION: Header file of the tombstone store of dead members
+ **********************************/
+
+#ifndef TOMBSTONES_H_
+#define TOMBSTONES_H_
+
+#include "stdincludes.h"
+
+/**
+ * STRUCT NAME: Tombstone
+ *
+ * DESCRIPTION: What is left of a dead member: the incarnation it died at, the change sequence
+ * 				number of its burial for delta gossip, and the time bucket it expires with
+ */
+typedef struct Tombstone {
+	long incarnation;
+	long updated;
+	long bucket;
+}Tombstone;
+
+/**
+ * CLASS NAME: TombstoneStore
+ *
+ * DESCRIPTION: Dead members, kept out of the membership list so that it only holds live ones,
+ * 				and remembered long enough that stale gossip cannot bring them back.
+ * 				Burials are grouped in time buckets of width time units; a tombstone lives
+ * 				for count buckets and a whole bucket expires at once, without scanning the rest.
+ * 				Tombstones are keyed by the address key of the member, so walking the store
+ * 				goes in address order.
+ */
+class TombstoneStore {
+private:
+	map<long, Tombstone> graves;
+	// keys buried in each bucket, a ring indexed by bucket number modulo its size
+	vector< vector<long> > buckets;
+	long width;
+	// newest bucket number seen by expire
+	long current;
+	void expireBucket(long bucket);
+public:
+	TombstoneStore(int count, int width);
+	void bury(long key, long incarnation, long updated, long time);
+	bool covers(long key, long incarnation);
+	void lift(long key);
+	long incarnationOf(long key);
+	void expire(long time);
+	void clear();
+	map<long, Tombstone>::iterator begin() {
+		return graves.begin();
+	}
+	map<long, Tombstone>::iterator end() {
+		return graves.end();
+	}
+	size_t size() {
+		return graves.size();
+	}
+	virtual ~TombstoneStore() {}
+};
+
+#endif /* TOMBSTONES_H_ */
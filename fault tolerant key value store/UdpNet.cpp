@@ -0,0 +1,324 @@
+/**********************************
+ * FILE NAME: UdpNet.cpp
+ *
+ * DESCRIPTION: UDP loopback transport definition
+ **********************************/
+
+#include "UdpNet.h"
+
+/**
+ * Constructor
+ */
+UdpNet::UdpNet(Params *p, int basePort): EmulNet(p), basePort(basePort), pendingSends(0), sendErrors(0) {}
+
+/**
+ * Destructor
+ */
+UdpNet::~UdpNet() {
+	for ( unsigned int i = 0; i < sockets.size(); i++ ) {
+		if ( sockets[i] >= 0 ) {
+			close(sockets[i]);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: slotOf
+ *
+ * DESCRIPTION: Index of the socket of a node Address on channel, distinct for every id, port and channel.
+ * 				An Address outside the slots the transport can have is a fatal error.
+ */
+int UdpNet::slotOf(Address *addr, int channel) {
+	int id = *(int *)(addr->addr);
+	short port = *(short *)(&addr->addr[4]);
+	if ( id < 0 || port < 0 || port >= UDP_MAX_PORTS ) {
+		cout<<"UdpNet: address "<<addr->getAddress()<<" has no socket, ports go up to "<<UDP_MAX_PORTS - 1<<endl;
+		exit(1);
+	}
+	return (id * UDP_MAX_PORTS + port) * EN_CHANNELS + channel;
+}
+
+/**
+ * FUNCTION NAME: udpPort
+ *
+ * DESCRIPTION: Loopback port a node Address is reachable on for channel.
+ * 				A group too large for the ports above basePort is a fatal error.
+ */
+unsigned short UdpNet::udpPort(Address *addr, int channel) {
+	long port = (long) basePort + slotOf(addr, channel);
+	if ( port > 65535 ) {
+		cout<<"UdpNet: address "<<addr->getAddress()<<" needs port "<<port<<", past 65535 with base port "<<basePort<<endl;
+		exit(1);
+	}
+	return (unsigned short) port;
+}
+
+/**
+ * FUNCTION NAME: socketOf
+ *
+ * DESCRIPTION: Socket of a node on channel, bound on first use
+ *
+ * RETURNS:
+ * file descriptor, or a negative value if the node lives in another process
+ */
+int UdpNet::socketOf(Address *addr, int channel) {
+	int id = slotOf(addr, channel);
+	assert(id >= 0);
+
+	if ( id >= (int) sockets.size() ) {
+		sockets.resize(id + 1, -1);
+		outbox.resize(id + 1);
+	}
+	if ( sockets[id] != -1 ) {
+		return sockets[id];
+	}
+
+	int fd = socket(AF_INET, SOCK_DGRAM, 0);
+	if ( fd < 0 ) {
+		perror("UdpNet socket");
+		exit(1);
+	}
+	int rcvbuf = UDP_RCVBUF;
+	setsockopt(fd, SOL_SOCKET, SO_RCVBUF, &rcvbuf, sizeof(rcvbuf));
+	fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+
+	struct sockaddr_in sin;
+	memset(&sin, 0, sizeof(sin));
+	sin.sin_family = AF_INET;
+	sin.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	sin.sin_port = htons(udpPort(addr, channel));
+	if ( bind(fd, (struct sockaddr *)&sin, sizeof(sin)) < 0 ) {
+		close(fd);
+		sockets[id] = -2;
+		return sockets[id];
+	}
+
+	sockets[id] = fd;
+	return fd;
+}
+
+/**
+ * FUNCTION NAME: ENinit
+ *
+ * DESCRIPTION: Give this node an emulnet id and bind its socket on every channel
+ */
+void *UdpNet::ENinit(Address *myaddr, short port) {
+	int id = emulnet.nextid++;
+	*(int *)(myaddr->addr) = id;
+	*(short *)(&myaddr->addr[4]) = 0;
+
+	for ( int channel = 0; channel < EN_CHANNELS; channel++ ) {
+		if ( socketOf(myaddr, channel) < 0 ) {
+			cout<<"UdpNet: port "<<udpPort(myaddr, channel)<<" is already in use"<<endl;
+			exit(1);
+		}
+	}
+	return myaddr;
+}
+
+/**
+ * FUNCTION NAME: ENsendMulti
+ *
+ * DESCRIPTION: Queue a datagram per destination in the sender's outbox, all sharing one buffer.
+ * 				They go on the wire with the next batch, at the latest before any node receives.
+ *
+ * RETURNS:
+ * size if at least one destination got the message, 0 otherwise
+ */
+int UdpNet::ENsendMulti(Address *myaddr, Address *toaddrs, int count, char *data, int size, int channel, int *status) {
+	en_msg *em = NULL;
+	int src = *(int *)(myaddr->addr);
+	int slot = slotOf(myaddr, channel);
+	int type = msgType(channel, data, size);
+
+	for ( int i = 0; status != NULL && i < count; i++ ) {
+		status[i] = EN_DROPPED;
+	}
+	lastSendStatus = EN_DROPPED;
+
+	if( (size + (int)sizeof(en_msg) >= par->MAX_MSG_SIZE) || (size + (int)sizeof(en_msg) > UDP_MAX_DGRAM) ) {
+		return 0;
+	}
+	if ( socketOf(myaddr, channel) < 0 ) {
+		return 0;
+	}
+
+	for ( int i = 0; i < count; i++ ) {
+		Address *toaddr = &toaddrs[i];
+		int sendmsg = rand() % 100;
+
+		lastSendStatus = EN_DROPPED;
+
+		if ( par->dropmsg && sendmsg < (int) (par->MSG_DROP_PROB * 100) ) {
+			continue;
+		}
+		if ( faults.isEnabled() && faults.blocks(src, *(int *)(toaddr->addr), par->getcurrtime()) ) {
+			continue;
+		}
+		// binds the destination too when it lives in this process, so nothing is sent to a closed port
+		socketOf(toaddr, channel);
+
+		if ( em == NULL ) {
+			em = new (pool.allocate(sizeof(en_msg) + size)) en_msg();
+			em->size = size;
+			em->refs = 0;
+			em->channel = channel;
+			em->from = *myaddr;
+			em->to = *toaddr;
+			memcpy((char *)(em + 1), data, size);
+		}
+		em->refs++;
+
+		if ( capture.isOpen() ) {
+			capture.write(par->getcurrtime(), src, *(int *)(toaddr->addr), channel, data, size);
+		}
+
+		outbox[slot].push_back(make_pair(em, *toaddr));
+		pendingSends++;
+		lastSendStatus = EN_SENT;
+		if ( status != NULL ) {
+			status[i] = EN_SENT;
+		}
+		sent_msgs.incr(src, par->getcurrtime());
+		traffic.sent(src, par->getcurrtime(), type, size);
+	}
+
+	if ( (int) outbox[slot].size() >= UDP_BATCH ) {
+		flushSender(slot);
+	}
+
+	return em != NULL ? size : 0;
+}
+
+/**
+ * FUNCTION NAME: flushSender
+ *
+ * DESCRIPTION: Push everything in one sender socket's outbox through sendmmsg
+ */
+void UdpNet::flushSender(int slot) {
+	vector< pair<en_msg *, Address> > &out = outbox[slot];
+	int channel = slot % EN_CHANNELS;
+	struct mmsghdr msgs[UDP_BATCH];
+	struct iovec iovecs[UDP_BATCH];
+	struct sockaddr_in dests[UDP_BATCH];
+	unsigned int done = 0;
+
+	while ( done < out.size() ) {
+		unsigned int n = min((unsigned int) UDP_BATCH, (unsigned int) out.size() - done);
+		memset(msgs, 0, sizeof(msgs));
+		for ( unsigned int i = 0; i < n; i++ ) {
+			en_msg *em = out[done + i].first;
+			memset(&dests[i], 0, sizeof(dests[i]));
+			dests[i].sin_family = AF_INET;
+			dests[i].sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+			dests[i].sin_port = htons(udpPort(&out[done + i].second, channel));
+			iovecs[i].iov_base = em;
+			iovecs[i].iov_len = sizeof(en_msg) + em->size;
+			msgs[i].msg_hdr.msg_name = &dests[i];
+			msgs[i].msg_hdr.msg_namelen = sizeof(dests[i]);
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		int sent = sendmmsg(sockets[slot], msgs, n, 0);
+		if ( sent <= 0 ) {
+			// the socket is full or the call failed, what is left of the batch is lost like any UDP datagram
+			sendErrors += n;
+			sent = n;
+		}
+		done += sent;
+	}
+
+	for ( unsigned int i = 0; i < out.size(); i++ ) {
+		ENrelease(out[i].first + 1);
+	}
+	pendingSends -= out.size();
+	out.clear();
+}
+
+/**
+ * FUNCTION NAME: flush
+ *
+ * DESCRIPTION: Push every outbox on the wire
+ */
+void UdpNet::flush() {
+	for ( unsigned int i = 0; i < outbox.size() && pendingSends > 0; i++ ) {
+		if ( !outbox[i].empty() ) {
+			flushSender(i);
+		}
+	}
+}
+
+/**
+ * FUNCTION NAME: ENrecv
+ *
+ * DESCRIPTION: Drain this node's socket on channel. Every datagram is copied once into a pool buffer
+ * 				that the consumer gives back through ENrelease, as with EmulNet.
+ *
+ * RETURN:
+ * 0
+ */
+int UdpNet::ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue, int channel) {
+	struct mmsghdr msgs[UDP_BATCH];
+	struct iovec iovecs[UDP_BATCH];
+	int dst = *(int *)(myaddr->addr);
+	int got;
+
+	flush();
+
+	int fd = socketOf(myaddr, channel);
+	if ( fd < 0 ) {
+		return 0;
+	}
+
+	do {
+		memset(msgs, 0, sizeof(msgs));
+		for ( int i = 0; i < UDP_BATCH; i++ ) {
+			iovecs[i].iov_base = rxbuf[i];
+			iovecs[i].iov_len = UDP_MAX_DGRAM;
+			msgs[i].msg_hdr.msg_iov = &iovecs[i];
+			msgs[i].msg_hdr.msg_iovlen = 1;
+		}
+
+		got = recvmmsg(fd, msgs, UDP_BATCH, MSG_DONTWAIT, NULL);
+		for ( int i = 0; i < got; i++ ) {
+			en_msg *hdr = (en_msg *)rxbuf[i];
+			if ( msgs[i].msg_len < sizeof(en_msg) || msgs[i].msg_len != sizeof(en_msg) + hdr->size ) {
+				continue;
+			}
+			en_msg *em = new (pool.allocate(msgs[i].msg_len)) en_msg();
+			em->size = hdr->size;
+			em->from = hdr->from;
+			em->to = hdr->to;
+			em->channel = hdr->channel;
+			em->refs = 1;
+			memcpy((char *)(em + 1), rxbuf[i] + sizeof(en_msg), hdr->size);
+
+			(*enq)(queue, (char *)(em+1), em->size);
+
+			recv_msgs.incr(dst, par->getcurrtime());
+			traffic.received(dst, par->getcurrtime(), msgType(channel, (char *)(em+1), em->size), em->size);
+		}
+	} while ( got == UDP_BATCH );
+
+	return 0;
+}
+
+/**
+ * FUNCTION NAME: ENcleanup
+ *
+ * DESCRIPTION: Push out what is still queued, close the sockets and write the usual logs
+ */
+int UdpNet::ENcleanup() {
+	flush();
+	for ( unsigned int i = 0; i < sockets.size(); i++ ) {
+		if ( sockets[i] >= 0 ) {
+			close(sockets[i]);
+			sockets[i] = -1;
+		}
+	}
+	if ( sendErrors > 0 ) {
+		cout<<"UdpNet: "<<sendErrors<<" datagrams could not be sent"<<endl;
+	}
+	return EmulNet::ENcleanup();
+}
@@ -0,0 +1,70 @@
+/**********************************
+ * FILE NAME: UdpNet.h
+ *
+ * DESCRIPTION: UDP loopback transport header file
+ **********************************/
+
+#ifndef _UDPNET_H_
+#define _UDPNET_H_
+
+#include "stdincludes.h"
+#include "EmulNet.h"
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+
+/*
+ * Macros
+ */
+// datagrams moved per sendmmsg/recvmmsg call
+#define UDP_BATCH 64
+// largest datagram accepted from the wire
+#define UDP_MAX_DGRAM 4096
+// receive buffer asked of the kernel for every socket
+#define UDP_RCVBUF (1 << 20)
+// ports a node id can have, 0 to UDP_MAX_PORTS - 1
+#define UDP_MAX_PORTS 4
+
+/**
+ * CLASS NAME: UdpNet
+ *
+ * DESCRIPTION: Transport with the EmulNet contract backed by non-blocking UDP sockets on 127.0.0.1.
+ * 				Every node gets a socket per channel bound to basePort + slotOf(Address, channel),
+ * 				one slot per emulnet id, port and channel of an Address. Sockets are bound the first time a node
+ * 				sends or is sent to on a channel. A port that is already
+ * 				bound elsewhere belongs to a node living in another process and is only sent to.
+ * 				Datagrams carry the en_msg header followed by the payload.
+ * 				Sends are batched per sender and pushed with sendmmsg before the next receive,
+ * 				receives drain the socket with recvmmsg. A multicast puts one buffer on the
+ * 				wire once per destination without copying it.
+ * 				There is no credit based flow control, the socket buffers are the only limit,
+ * 				so a send is either EN_SENT or EN_DROPPED.
+ */
+class UdpNet : public EmulNet
+{
+private:
+	int basePort;
+	// socket of every node and channel, indexed by slotOf; -1 not bound yet, -2 remote
+	vector<int> sockets;
+	// datagrams waiting for the next sendmmsg and where they go, indexed like sockets
+	vector< vector< pair<en_msg *, Address> > > outbox;
+	int pendingSends;
+	long sendErrors;
+	// scratch space recvmmsg writes into
+	char rxbuf[UDP_BATCH][UDP_MAX_DGRAM];
+	int slotOf(Address *addr, int channel);
+	unsigned short udpPort(Address *addr, int channel);
+	int socketOf(Address *addr, int channel);
+	void flush();
+	void flushSender(int slot);
+public:
+	UdpNet(Params *p, int basePort);
+	virtual ~UdpNet();
+	using EmulNet::ENsendMulti;
+	void *ENinit(Address *myaddr, short port);
+	int ENsendMulti(Address *myaddr, Address *toaddrs, int count, char *data, int size, int channel, int *status = NULL);
+	int ENrecv(Address *myaddr, int (* enq)(void *, char *, int), struct timeval *t, int times, void *queue, int channel);
+	int ENcleanup();
+};
+
+#endif /* _UDPNET_H_ */